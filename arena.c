@@ -1,12 +1,58 @@
 mem_arena* arena_create(u64 reserve_size, u64 commit_size) {
-    u32 pagesize = plat_get_pagesize();
+    mem_arena_desc desc = {
+        .reserve_size = reserve_size,
+        .commit_size = commit_size,
+    };
+
+    return arena_create_ex(&desc);
+}
+
+mem_arena* arena_create_ex(const mem_arena_desc* desc) {
+    u64 pagesize = plat_get_pagesize();
+    u32 flags = desc->flags;
+
+    if (flags & ARENA_FLAG_CONCURRENT) {
+        flags &= ~ARENA_FLAG_CHAINED;
+    }
+
+    if (flags & (ARENA_FLAG_HUGE_PAGES | ARENA_FLAG_HUGETLB)) {
+        pagesize = MAX(pagesize, ARENA_HUGE_PAGE_SIZE);
+    }
 
-    reserve_size = ALIGN_UP_POW2(reserve_size, pagesize);
-    commit_size = ALIGN_UP_POW2(commit_size, pagesize);
+    u64 reserve_size = ALIGN_UP_POW2(desc->reserve_size, pagesize);
+    u64 commit_size = ALIGN_UP_POW2(desc->commit_size, pagesize);
+    commit_size = MIN(commit_size, reserve_size);
 
-    mem_arena* arena = plat_mem_reserve(reserve_size);
+    mem_arena* arena = NULL;
+
+    if (flags & ARENA_FLAG_HUGETLB) {
+        arena = plat_mem_reserve_hugetlb(reserve_size);
+
+        if (arena == NULL) {
+            flags = (flags & ~ARENA_FLAG_HUGETLB) | ARENA_FLAG_HUGE_PAGES;
+        }
+    }
+
+    if (arena == NULL && (flags & ARENA_FLAG_HUGE_PAGES)) {
+        arena = plat_mem_reserve_aligned(reserve_size, ARENA_HUGE_PAGE_SIZE);
+
+        // Only a hint, the arena works the same without it
+        if (arena != NULL) {
+            plat_mem_advise_huge_pages(arena, reserve_size);
+        }
+    } else if (arena == NULL) {
+        arena = plat_mem_reserve(reserve_size);
+    }
+
+    if (arena == NULL) { return NULL; }
+
+    // Before the commit, so even the header page lands on the node
+    if ((flags & ARENA_FLAG_NUMA_NODE) && !plat_mem_bind_node(arena, reserve_size, desc->numa_node)) {
+        flags &= ~ARENA_FLAG_NUMA_NODE;
+    }
 
     if (!plat_mem_commit(arena, commit_size)) {
+        plat_mem_release(arena, reserve_size);
         return NULL;
     }
 
@@ -14,55 +60,334 @@ mem_arena* arena_create(u64 reserve_size, u64 commit_size) {
     arena->commit_size = commit_size;
     arena->pos = ARENA_BASE_POS;
     arena->commit_pos = commit_size;
-    
+    arena->zero_pos = ARENA_BASE_POS;
+    arena->decommit_threshold = desc->decommit_threshold;
+    arena->flags = flags;
+    arena->numa_node = desc->numa_node;
+    arena->current = arena;
+
+#if ARENA_STATS
+    // The rest of the header is still zero from the OS
+    arena->stats.peak_pos = ARENA_BASE_POS;
+    arena->stats.peak_commit_pos = commit_size;
+    arena->stats.num_commits = 1;
+#endif
+
     return arena;
 }
 
 void arena_destroy(mem_arena* arena) {
+    mem_arena* block = arena->current;
+
+    while (block != arena) {
+        mem_arena* prev = block->prev;
+        plat_mem_release(block, block->reserve_size);
+        block = prev;
+    }
+
     plat_mem_release(arena, arena->reserve_size);
 }
 
-void* arena_push(mem_arena* arena, u64 size, b32 non_zero) {
-    u64 pos_aligned = ALIGN_UP_POW2(arena->pos, ARENA_ALIGN);
+u64 arena_get_pos(const mem_arena* arena) {
+    const mem_arena* current = arena->current;
+    return current->base_pos + current->pos;
+}
+
+#if ARENA_STATS
+static void arena_stats_record_site(mem_arena_stats* stats, const char* file, u32 line, u64 size) {
+    mem_arena_site* site = NULL;
+
+    // Sites are few and __FILE__ strings are pooled, so comparing pointers is enough
+    for (u32 i = 0; i < stats->num_sites; i++) {
+        if (stats->sites[i].file == file && stats->sites[i].line == line) {
+            site = &stats->sites[i];
+            break;
+        }
+    }
+
+    if (site == NULL) {
+        if (stats->num_sites < ARENA_STATS_MAX_SITES) {
+            site = &stats->sites[stats->num_sites++];
+            site->file = file;
+            site->line = line;
+        } else {
+            site = &stats->sites[ARENA_STATS_MAX_SITES - 1];
+            site->file = "(other)";
+            site->line = 0;
+        }
+    }
+
+    site->pushes++;
+    site->bytes += size;
+}
+#endif
+
+// Bumps block, which is arena itself or one chained onto it, NULL if it's full.
+// Counters always go to arena.
+static void* arena_block_push(mem_arena* arena, mem_arena* block, u64 size, u64 align, b32 non_zero) {
+    (void)arena;
+
+    u64 base = (u64)block;
+    u64 pos_aligned = ALIGN_UP_POW2(base + block->pos, align) - base;
     u64 new_pos = pos_aligned + size;
 
-    if (new_pos > arena->reserve_size) { return NULL; }
+    if (new_pos > block->reserve_size) { return NULL; }
 
-    if (new_pos > arena->commit_pos) {
+    if (new_pos > block->commit_pos) {
         u64 new_commit_pos = new_pos;
-        new_commit_pos += arena->commit_size - 1;
-        new_commit_pos -= new_commit_pos % arena->commit_size;
-        new_commit_pos = MIN(new_commit_pos, arena->reserve_size);
+        new_commit_pos += block->commit_size - 1;
+        new_commit_pos -= new_commit_pos % block->commit_size;
+        new_commit_pos = MIN(new_commit_pos, block->reserve_size);
 
-        u8* mem = (u8*)arena + arena->commit_pos;
-        u64 commit_size = new_commit_pos - arena->commit_pos;
+        u8* mem = (u8*)block + block->commit_pos;
+        u64 commit_size = new_commit_pos - block->commit_pos;
 
         if (!plat_mem_commit(mem, commit_size)) {
             return NULL;
         }
 
-        arena->commit_pos = new_commit_pos;
+        block->commit_pos = new_commit_pos;
+
+#if ARENA_STATS
+        arena->stats.num_commits++;
+        arena->stats.peak_commit_pos = MAX(arena->stats.peak_commit_pos, block->base_pos + new_commit_pos);
+#endif
     }
 
-    arena->pos = new_pos;
+    block->pos = new_pos;
+
+    u8* out = (u8*)block + pos_aligned;
+
+    if (!non_zero && pos_aligned < block->zero_pos) {
+        u64 zero_size = MIN(new_pos, block->zero_pos) - pos_aligned;
+        memset(out, 0, zero_size);
+
+#if ARENA_STATS
+        arena->stats.bytes_zeroed += zero_size;
+#endif
+    }
+
+    block->zero_pos = MAX(block->zero_pos, new_pos);
+
+#if ARENA_STATS
+    arena->stats.peak_pos = MAX(arena->stats.peak_pos, block->base_pos + new_pos);
+#endif
+
+    return out;
+}
+
+// Starts a block after the current one that fits at least size bytes at align
+static mem_arena* arena_chain_block(mem_arena* arena, u64 size, u64 align) {
+    mem_arena* current = arena->current;
+
+    mem_arena_desc desc = {
+        .reserve_size = MAX(arena->reserve_size, ARENA_BASE_POS + size + align),
+        .commit_size = arena->commit_size,
+        .flags = arena->flags,
+        .decommit_threshold = arena->decommit_threshold,
+        .numa_node = arena->numa_node,
+    };
+
+    mem_arena* block = arena_create_ex(&desc);
+    if (block == NULL) { return NULL; }
+
+    // Positions keep increasing across blocks, so temps and pops work on the whole chain
+    block->prev = current;
+    block->base_pos = current->base_pos + current->reserve_size;
+    arena->current = block;
+
+#if ARENA_STATS
+    arena->stats.num_blocks++;
+    arena->stats.num_commits++;
+    arena->stats.peak_commit_pos = MAX(arena->stats.peak_commit_pos, block->base_pos + block->commit_pos);
+#endif
+
+    return block;
+}
+
+static void arena_commit_lock(u32* lock) {
+    while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE) != 0) {
+        // Wait on a plain load so the line isn't bounced between the waiters
+        while (__atomic_load_n(lock, __ATOMIC_RELAXED) != 0) {}
+    }
+}
+
+static void arena_commit_unlock(u32* lock) {
+    __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+// pos always stays a multiple of ARENA_ALIGN here, so a push takes its size
+// rounded up to that plus the worst case padding for align in one atomic add.
+// Nothing below zero_pos moves while pushes are in flight, pops update it.
+static void* arena_concurrent_push(mem_arena* arena, u64 size, u64 align, b32 non_zero) {
+    u64 padding = align > ARENA_ALIGN ? align - ARENA_ALIGN : 0;
+    u64 taken = ALIGN_UP_POW2(size, ARENA_ALIGN) + padding;
+
+    u64 pos = __atomic_fetch_add(&arena->pos, taken, __ATOMIC_RELAXED);
+    if (pos + taken > arena->reserve_size) { return NULL; }
+
+    u64 base = (u64)arena;
+    u64 pos_aligned = ALIGN_UP_POW2(base + pos, align) - base;
+    u64 new_pos = pos_aligned + size;
+
+    if (new_pos > __atomic_load_n(&arena->commit_pos, __ATOMIC_ACQUIRE)) {
+        arena_commit_lock(&arena->commit_lock);
+
+        // Someone else may have committed far enough while this thread waited
+        u64 commit_pos = __atomic_load_n(&arena->commit_pos, __ATOMIC_RELAXED);
+
+        if (new_pos > commit_pos) {
+            u64 new_commit_pos = new_pos;
+            new_commit_pos += arena->commit_size - 1;
+            new_commit_pos -= new_commit_pos % arena->commit_size;
+            new_commit_pos = MIN(new_commit_pos, arena->reserve_size);
+
+            if (!plat_mem_commit((u8*)arena + commit_pos, new_commit_pos - commit_pos)) {
+                arena_commit_unlock(&arena->commit_lock);
+                return NULL;
+            }
+
+            __atomic_store_n(&arena->commit_pos, new_commit_pos, __ATOMIC_RELEASE);
+
+#if ARENA_STATS
+            arena->stats.num_commits++;
+            arena->stats.peak_commit_pos = MAX(arena->stats.peak_commit_pos, new_commit_pos);
+#endif
+        }
+
+        arena_commit_unlock(&arena->commit_lock);
+    }
 
     u8* out = (u8*)arena + pos_aligned;
 
-    if (!non_zero) {
-        memset(out, 0, size);
+    if (!non_zero && pos_aligned < arena->zero_pos) {
+        u64 zero_size = MIN(new_pos, arena->zero_pos) - pos_aligned;
+        memset(out, 0, zero_size);
+
+#if ARENA_STATS
+        __atomic_fetch_add(&arena->stats.bytes_zeroed, zero_size, __ATOMIC_RELAXED);
+#endif
     }
 
+#if ARENA_STATS
+    __atomic_fetch_add(&arena->stats.num_pushes, 1, __ATOMIC_RELAXED);
+#endif
+
     return out;
 }
 
+// file is NULL for pushes that didn't come through ARENA_PUSH
+static void* arena_push_internal(mem_arena* arena, u64 size, u64 align, b32 non_zero, const char* file, u32 line) {
+    (void)file;
+    (void)line;
+
+    if (arena->flags & ARENA_FLAG_CONCURRENT) {
+        return arena_concurrent_push(arena, size, align, non_zero);
+    }
+
+    void* out = arena_block_push(arena, arena->current, size, align, non_zero);
+
+    if (out == NULL && (arena->flags & ARENA_FLAG_CHAINED)) {
+        mem_arena* block = arena_chain_block(arena, size, align);
+
+        if (block != NULL) {
+            out = arena_block_push(arena, block, size, align, non_zero);
+        }
+    }
+
+    if (out == NULL) { return NULL; }
+
+#if ARENA_STATS
+    arena->stats.num_pushes++;
+    arena_stats_record_site(&arena->stats, file != NULL ? file : "(direct call)", line, size);
+#endif
+
+    return out;
+}
+
+void* arena_push(mem_arena* arena, u64 size, b32 non_zero) {
+    return arena_push_internal(arena, size, ARENA_ALIGN, non_zero, NULL, 0);
+}
+
+void* arena_push_aligned(mem_arena* arena, u64 size, u64 align, b32 non_zero) {
+    return arena_push_internal(arena, size, align, non_zero, NULL, 0);
+}
+
+void* arena_push_site(mem_arena* arena, u64 size, u64 align, b32 non_zero, const char* file, u32 line) {
+    return arena_push_internal(arena, size, align, non_zero, file, line);
+}
+
+// Keeps whole commit blocks up to the block's pos
+static void arena_decommit_to_pos(mem_arena* arena, mem_arena* block) {
+    (void)arena;
+
+    u64 new_commit_pos = block->pos;
+    new_commit_pos += block->commit_size - 1;
+    new_commit_pos -= new_commit_pos % block->commit_size;
+
+    if (new_commit_pos >= block->commit_pos) { return; }
+
+    u8* mem = (u8*)block + new_commit_pos;
+    u64 size = block->commit_pos - new_commit_pos;
+
+    if (block->flags & ARENA_FLAG_LAZY_DECOMMIT) {
+        if (!plat_mem_decommit_lazy(mem, size)) { return; }
+    } else {
+        if (!plat_mem_decommit(mem, size)) { return; }
+
+        // Whatever comes back is freshly zeroed
+        block->zero_pos = MIN(block->zero_pos, new_commit_pos);
+    }
+
+    block->commit_pos = new_commit_pos;
+
+#if ARENA_STATS
+    arena->stats.num_decommits++;
+#endif
+}
+
 void arena_pop(mem_arena* arena, u64 size) {
-    size = MIN(size, arena->pos - ARENA_BASE_POS);
-    arena->pos -= size;
+    u64 pos = arena_get_pos(arena);
+    pos = size < pos - ARENA_BASE_POS ? pos - size : ARENA_BASE_POS;
+
+    arena_pop_to(arena, pos);
+}
+
+void arena_trim(mem_arena* arena) {
+    arena_decommit_to_pos(arena, arena->current);
 }
 
 void arena_pop_to(mem_arena* arena, u64 pos) {
-    u64 size = pos < arena->pos ? arena->pos - pos : 0;
-    arena_pop(arena, size);
+    mem_arena* current = arena->current;
+
+    // Blocks that start past pos go back to the OS whole
+    while (current != arena && pos < current->base_pos + ARENA_BASE_POS) {
+        mem_arena* prev = current->prev;
+        plat_mem_release(current, current->reserve_size);
+        current = prev;
+    }
+
+    arena->current = current;
+
+    u64 local_pos = MAX(pos - current->base_pos, ARENA_BASE_POS);
+    if (local_pos >= current->pos) { return; }
+
+    if (current->flags & ARENA_FLAG_CONCURRENT) {
+        // Concurrent pushes leave zero_pos and the peak alone, and pos may be past
+        // the reservation after pushes that failed
+        current->zero_pos = MAX(current->zero_pos, MIN(current->pos, current->commit_pos));
+        local_pos = ALIGN_UP_POW2(local_pos, ARENA_ALIGN);
+
+#if ARENA_STATS
+        arena->stats.peak_pos = MAX(arena->stats.peak_pos, MIN(current->pos, current->reserve_size));
+#endif
+    }
+
+    current->pos = local_pos;
+
+    if (current->decommit_threshold != 0 && current->commit_pos - current->pos > current->decommit_threshold) {
+        arena_decommit_to_pos(arena, current);
+    }
 }
 
 void arena_clear(mem_arena* arena) {
@@ -72,7 +397,7 @@ void arena_clear(mem_arena* arena) {
 mem_arena_temp arena_temp_begin(mem_arena* arena) {
     return (mem_arena_temp) {
         .arena = arena,
-        .start_pos = arena->pos
+        .start_pos = arena_get_pos(arena)
     };
 }
 
@@ -80,12 +405,29 @@ void arena_temp_end(mem_arena_temp temp) {
     arena_pop_to(temp.arena, temp.start_pos);
 }
 
-static __thread mem_arena* _scratch_arenas[2] = { NULL, NULL };
+static mem_arena_scratch_desc _scratch_desc = {
+    .count = 4,
+    .reserve_size = MiB(64),
+    .commit_size = MiB(1),
+    // Gives back whatever an unusually large step left committed
+    .decommit_threshold = MiB(16),
+};
 
-mem_arena_temp arena_scratch_get(mem_arena** conflicts, u32 num_conflicts) {
-    i32 scratch_index = -1;
+static __thread mem_arena* _scratch_arenas[ARENA_SCRATCH_MAX_COUNT] = { NULL };
+
+void arena_scratch_configure(const mem_arena_scratch_desc* desc) {
+    if (desc->count != 0) {
+        _scratch_desc.count = MIN(desc->count, ARENA_SCRATCH_MAX_COUNT);
+    }
+    if (desc->reserve_size != 0) { _scratch_desc.reserve_size = desc->reserve_size; }
+    if (desc->commit_size != 0) { _scratch_desc.commit_size = desc->commit_size; }
+    if (desc->has_decommit_threshold) { _scratch_desc.decommit_threshold = desc->decommit_threshold; }
+}
+
+b32 arena_scratch_try_get(mem_arena_temp* out, mem_arena** conflicts, u32 num_conflicts, u64 size_hint) {
+    *out = (mem_arena_temp){ 0 };
 
-    for (i32 i = 0; i < 2; i++) {
+    for (u32 i = 0; i < _scratch_desc.count; i++) {
         b32 conflict_found = false;
 
         for (u32 j = 0; j < num_conflicts; j++) {
@@ -95,29 +437,169 @@ mem_arena_temp arena_scratch_get(mem_arena** conflicts, u32 num_conflicts) {
             }
         }
 
-        if (!conflict_found) {
-            scratch_index = i;
-            break;
+        if (conflict_found) { continue; }
+
+        mem_arena** selected = &_scratch_arenas[i];
+
+        if (*selected == NULL) {
+            mem_arena_desc desc = {
+                .reserve_size = MAX(_scratch_desc.reserve_size, ARENA_BASE_POS + size_hint),
+                .commit_size = _scratch_desc.commit_size,
+                .flags = ARENA_FLAG_CHAINED,
+                .decommit_threshold = _scratch_desc.decommit_threshold,
+            };
+
+            *selected = arena_create_ex(&desc);
+            if (*selected == NULL) { return false; }
         }
-    }
 
-    if (scratch_index == -1) {
-        return (mem_arena_temp){ 0 };
+        *out = arena_temp_begin(*selected);
+        return true;
     }
 
-    mem_arena** selected = &_scratch_arenas[scratch_index];
+    return false;
+}
 
-    if (*selected == NULL) {
-        *selected = arena_create(MiB(64), MiB(1));
+mem_arena_temp arena_scratch_get_ex(mem_arena** conflicts, u32 num_conflicts, u64 size_hint) {
+    mem_arena_temp scratch;
+
+    if (!arena_scratch_try_get(&scratch, conflicts, num_conflicts, size_hint)) {
+        if (num_conflicts >= _scratch_desc.count) {
+            fprintf(
+                stderr, "Out of scratch arenas, %u conflicts with %u per thread\n",
+                num_conflicts, _scratch_desc.count
+            );
+        } else {
+            fprintf(stderr, "Failed to create a scratch arena\n");
+        }
+        abort();
     }
 
-    return arena_temp_begin(*selected);
+    return scratch;
+}
+
+mem_arena_temp arena_scratch_get(mem_arena** conflicts, u32 num_conflicts) {
+    return arena_scratch_get_ex(conflicts, num_conflicts, 0);
 }
 
 void arena_scratch_release(mem_arena_temp scratch) {
     arena_temp_end(scratch);
 }
 
+void arena_scratch_thread_release(void) {
+    for (u32 i = 0; i < ARENA_SCRATCH_MAX_COUNT; i++) {
+        if (_scratch_arenas[i] == NULL) { continue; }
+
+        arena_destroy(_scratch_arenas[i]);
+        _scratch_arenas[i] = NULL;
+    }
+}
+
+void pool_init(mem_pool* pool, mem_arena* arena, u64 item_size) {
+    *pool = (mem_pool){
+        .arena = arena,
+        // Freed items hold the free list link
+        .item_size = ALIGN_UP_POW2(MAX(item_size, sizeof(mem_pool_node)), ARENA_ALIGN),
+    };
+}
+
+void* pool_alloc(mem_pool* pool, b32 non_zero) {
+    void* item = pool->free_list;
+
+    if (item != NULL) {
+        pool->free_list = pool->free_list->next;
+    } else {
+        // No pointer arithmetic on chunk_pos before the first chunk, it's still NULL
+        if (pool->chunk_pos == NULL || (u64)(pool->chunk_end - pool->chunk_pos) < pool->item_size) {
+            u64 chunk_size = MAX(ARENA_POOL_CHUNK_SIZE / pool->item_size, 1) * pool->item_size;
+
+            u8* chunk = (u8*)ARENA_PUSH(pool->arena, chunk_size, ARENA_SIMD_ALIGN, true);
+            if (chunk == NULL) { return NULL; }
+
+            pool->chunk_pos = chunk;
+            pool->chunk_end = chunk + chunk_size;
+        }
+
+        item = pool->chunk_pos;
+        pool->chunk_pos += pool->item_size;
+    }
+
+    if (!non_zero) {
+        memset(item, 0, pool->item_size);
+    }
+
+    return item;
+}
+
+void pool_free(mem_pool* pool, void* item) {
+    if (item == NULL) { return; }
+
+    mem_pool_node* node = (mem_pool_node*)item;
+    node->next = pool->free_list;
+    pool->free_list = node;
+}
+
+#if ARENA_STATS
+
+void arena_stats_print(const mem_arena* arena, const char* name) {
+    const mem_arena_stats* stats = &arena->stats;
+    const mem_arena* current = arena->current;
+    const f64 mib = 1.0 / MiB(1);
+
+    fprintf(
+        stderr, "arena %s: pos %.2f MiB (peak %.2f), committed %.2f MiB (peak %.2f) of %.2f MiB\n",
+        name, arena_get_pos(arena) * mib, stats->peak_pos * mib,
+        (current->base_pos + current->commit_pos) * mib, stats->peak_commit_pos * mib,
+        (current->base_pos + current->reserve_size) * mib
+    );
+    fprintf(
+        stderr, "  %llu pushes, %llu commits, %llu decommits, %llu chained blocks, %.2f MiB zeroed\n",
+        (unsigned long long)stats->num_pushes, (unsigned long long)stats->num_commits,
+        (unsigned long long)stats->num_decommits, (unsigned long long)stats->num_blocks,
+        stats->bytes_zeroed * mib
+    );
+
+    // Biggest sites first
+    u32 order[ARENA_STATS_MAX_SITES];
+    for (u32 i = 0; i < stats->num_sites; i++) {
+        u32 j = i;
+        for (; j > 0 && stats->sites[order[j - 1]].bytes < stats->sites[i].bytes; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+    }
+
+    for (u32 i = 0; i < stats->num_sites; i++) {
+        const mem_arena_site* site = &stats->sites[order[i]];
+
+        fprintf(
+            stderr, "  %10.3f MiB in %8llu pushes  %s:%u\n",
+            site->bytes * mib, (unsigned long long)site->pushes, site->file, site->line
+        );
+    }
+}
+
+void arena_scratch_stats_print(void) {
+    for (u32 i = 0; i < ARENA_SCRATCH_MAX_COUNT; i++) {
+        if (_scratch_arenas[i] == NULL) { continue; }
+
+        char name[32];
+        snprintf(name, sizeof(name), "scratch %u", i);
+        arena_stats_print(_scratch_arenas[i], name);
+    }
+}
+
+#else
+
+void arena_stats_print(const mem_arena* arena, const char* name) {
+    (void)arena;
+    (void)name;
+}
+
+void arena_scratch_stats_print(void) {}
+
+#endif
+
 #if defined(_WIN32)
 
 #include <windows.h>
@@ -133,6 +615,33 @@ void* plat_mem_reserve(u64 size) {
     return VirtualAlloc(NULL, size, MEM_RESERVE, PAGE_READWRITE);
 }
 
+// Large pages need SeLockMemoryPrivilege and can't be committed lazily,
+// so arenas on Windows always use normal pages
+void* plat_mem_reserve_aligned(u64 size, u64 align) {
+    (void)align;
+    return plat_mem_reserve(size);
+}
+
+void* plat_mem_reserve_hugetlb(u64 size) {
+    (void)size;
+    return NULL;
+}
+
+b32 plat_mem_advise_huge_pages(void* ptr, u64 size) {
+    (void)ptr;
+    (void)size;
+    return false;
+}
+
+// VirtualAllocExNuma only takes the node when reserving or committing,
+// there is no way to attach it to a range afterwards
+b32 plat_mem_bind_node(void* ptr, u64 size, u32 node) {
+    (void)ptr;
+    (void)size;
+    (void)node;
+    return false;
+}
+
 b32 plat_mem_commit(void* ptr, u64 size) {
     void* ret = VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE);
     return ret != NULL;
@@ -142,6 +651,12 @@ b32 plat_mem_decommit(void* ptr, u64 size) {
     return VirtualFree(ptr, size, MEM_DECOMMIT);
 }
 
+// MEM_RESET keeps the commit charge, so a real decommit is what actually
+// lowers the process's footprint here
+b32 plat_mem_decommit_lazy(void* ptr, u64 size) {
+    return plat_mem_decommit(ptr, size);
+}
+
 b32 plat_mem_release(void* ptr, u64 size) {
     return VirtualFree(ptr, size, MEM_RELEASE);
 }
@@ -155,6 +670,7 @@ b32 plat_mem_release(void* ptr, u64 size) {
 
 #include <unistd.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
 
 u32 plat_get_pagesize(void) {
     return (u32)sysconf(_SC_PAGESIZE);
@@ -168,6 +684,70 @@ void* plat_mem_reserve(u64 size) {
     return out;
 }
 
+// Over-reserves by align and unmaps the slack on both sides
+void* plat_mem_reserve_aligned(u64 size, u64 align) {
+    u8* out = plat_mem_reserve(size + align);
+    if (out == NULL) {
+        return NULL;
+    }
+
+    u8* aligned = (u8*)ALIGN_UP_POW2((u64)out, align);
+    u64 head = aligned - out;
+    u64 tail = align - head;
+
+    if (head > 0) { munmap(out, head); }
+    if (tail > 0) { munmap(aligned + size, tail); }
+
+    return aligned;
+}
+
+void* plat_mem_reserve_hugetlb(u64 size) {
+#if defined(MAP_HUGETLB)
+    // Without MAP_NORESERVE the pages are taken from the pool now,
+    // so a short pool fails here instead of with SIGBUS on first touch
+    void* out = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (out == MAP_FAILED) {
+        return NULL;
+    }
+    return out;
+#else
+    (void)size;
+    return NULL;
+#endif
+}
+
+b32 plat_mem_advise_huge_pages(void* ptr, u64 size) {
+#if defined(MADV_HUGEPAGE)
+    return madvise(ptr, size, MADV_HUGEPAGE) == 0;
+#else
+    (void)ptr;
+    (void)size;
+    return false;
+#endif
+}
+
+// mbind without libnuma, the values are from <linux/mempolicy.h>
+#define PLAT_MPOL_BIND 2
+#define PLAT_MAX_NUMA_NODES 1024
+
+b32 plat_mem_bind_node(void* ptr, u64 size, u32 node) {
+#if defined(SYS_mbind)
+    if (node >= PLAT_MAX_NUMA_NODES) { return false; }
+
+    unsigned long mask[PLAT_MAX_NUMA_NODES / (8 * sizeof(unsigned long))] = { 0 };
+    mask[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+
+    // The kernel reads maxnode - 1 bits
+    long ret = syscall(SYS_mbind, ptr, size, PLAT_MPOL_BIND, mask, PLAT_MAX_NUMA_NODES + 1, 0);
+    return ret == 0;
+#else
+    (void)ptr;
+    (void)size;
+    (void)node;
+    return false;
+#endif
+}
+
 b32 plat_mem_commit(void* ptr, u64 size) {
     i32 ret = mprotect(ptr, size, PROT_READ | PROT_WRITE);
     return ret == 0;
@@ -180,6 +760,20 @@ b32 plat_mem_decommit(void* ptr, u64 size) {
     return ret == 0;
 }
 
+b32 plat_mem_decommit_lazy(void* ptr, u64 size) {
+#if defined(MADV_FREE)
+    i32 ret = mprotect(ptr, size, PROT_NONE);
+    if (ret != 0) return false;
+
+    // Kernels before 4.5 don't know MADV_FREE
+    if (madvise(ptr, size, MADV_FREE) == 0) return true;
+    ret = madvise(ptr, size, MADV_DONTNEED);
+    return ret == 0;
+#else
+    return plat_mem_decommit(ptr, size);
+#endif
+}
+
 b32 plat_mem_release(void* ptr, u64 size) {
     i32 ret = munmap(ptr, size);
     return ret == 0;
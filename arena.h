@@ -1,40 +1,237 @@
 #define ARENA_BASE_POS (sizeof(mem_arena))
 #define ARENA_ALIGN (sizeof(void*))
 
+// Alignment for anything SIMD code walks through, one cache line
+#define ARENA_SIMD_ALIGN 64
+
+#define ARENA_HUGE_PAGE_SIZE MiB(2)
+
+// Build with -DARENA_STATS=1 to have every arena count what it does,
+// otherwise the counters and the push site bookkeeping compile away
+#ifndef ARENA_STATS
+#define ARENA_STATS 0
+#endif
+
+#define ARENA_STATS_MAX_SITES 64
+
+// Upper bound on scratch arenas per thread, how many are used is configurable
+#define ARENA_SCRATCH_MAX_COUNT 8
+
+typedef enum {
+    ARENA_FLAG_NONE = 0,
+
+    // Transparent 2 MiB pages (MADV_HUGEPAGE), the reservation and commits
+    // are rounded to 2 MiB so every committed range can be backed by them
+    ARENA_FLAG_HUGE_PAGES = (1 << 0),
+    // Explicit 2 MiB pages from the preallocated pool (MAP_HUGETLB), taken for the
+    // whole reservation up front, falls back to ARENA_FLAG_HUGE_PAGES if the pool is too small
+    ARENA_FLAG_HUGETLB = (1 << 1),
+
+    // Decommitted pages are only marked reclaimable (MADV_FREE), the kernel takes them
+    // back under memory pressure and recommitting is cheaper if it hasn't.
+    // Plain decommits (MADV_DONTNEED) drop them right away.
+    ARENA_FLAG_LAZY_DECOMMIT = (1 << 2),
+
+    // A push past the reservation starts another block of reserve_size (or larger,
+    // for a push that wouldn't fit) instead of failing, so the reservation can be modest.
+    // Positions count across the whole chain, popping below a block releases it.
+    ARENA_FLAG_CHAINED = (1 << 3),
+
+    // Pushes may come from any number of threads at once, pos is bumped with an atomic add
+    // and only commits take a lock. Pops, temps and clears still need every pushing thread
+    // to be done, the usual pattern is one clear per step. Can't be chained,
+    // and pushes past the reservation fail until the next pop.
+    ARENA_FLAG_CONCURRENT = (1 << 4),
+
+    // Every page of the reservation comes from desc.numa_node (MPOL_BIND), whichever
+    // thread touches it first. Dropped if the kernel refuses, the arena works the same.
+    ARENA_FLAG_NUMA_NODE = (1 << 5),
+} mem_arena_flags;
+
 typedef struct {
     u64 reserve_size;
     u64 commit_size;
+    // mem_arena_flags, the huge page ones are ignored on Windows
+    u32 flags;
+
+    // Pops decommit once more than this is committed past pos, 0 never does.
+    // Anything less stays committed, so a pos bouncing around doesn't recommit every time.
+    u64 decommit_threshold;
+
+    // With ARENA_FLAG_NUMA_NODE
+    u32 numa_node;
+} mem_arena_desc;
+
+// Pushes that came through the PUSH_* macros or ARENA_PUSH, by file and line
+typedef struct {
+    const char* file;
+    u32 line;
+
+    u64 pushes;
+    u64 bytes;
+} mem_arena_site;
+
+// Positions are across the whole chain of a chained arena
+typedef struct {
+    u64 peak_pos;
+    u64 peak_commit_pos;
+
+    u64 num_pushes;
+    u64 num_commits;
+    u64 num_decommits;
+    u64 num_blocks;
+    // By pushes that asked for zeroed memory, not counting what the lazy zeroing skipped
+    u64 bytes_zeroed;
+
+    // The last one also collects every site that didn't fit, concurrent pushes aren't recorded
+    mem_arena_site sites[ARENA_STATS_MAX_SITES];
+    u32 num_sites;
+} mem_arena_stats;
+
+typedef struct mem_arena mem_arena;
 
+// Chained blocks are arenas too, only the first one's current, flags and stats matter
+struct mem_arena {
+    // The block pushes go to, the arena itself until it chains
+    mem_arena* current;
+    mem_arena* prev;
+    // Position of this block's first byte in the chain
+    u64 base_pos;
+
+    u64 reserve_size;
+    u64 commit_size;
+
+    // Within this block
     u64 pos;
     u64 commit_pos;
-} mem_arena;
+    // Everything from here to commit_pos has never been handed out since it was
+    // committed, so it's still the zeroes the OS gave us and pushes skip the memset
+    u64 zero_pos;
+
+    u64 decommit_threshold;
+    u32 flags;
+    u32 numa_node;
+    // Held while committing in a concurrent arena
+    u32 commit_lock;
+
+#if ARENA_STATS
+    mem_arena_stats stats;
+#endif
+};
+
+// Zero fields keep the defaults: 4 arenas of 64 MiB, committed 1 MiB at a time,
+// giving back what's more than 16 MiB past pos
+typedef struct {
+    // Per thread, at most ARENA_SCRATCH_MAX_COUNT
+    u32 count;
+    u64 reserve_size;
+    u64 commit_size;
+    // 0 is a real value here (never decommit), so it only applies with has_decommit_threshold set
+    u64 decommit_threshold;
+    b32 has_decommit_threshold;
+} mem_arena_scratch_desc;
+
+// Fixed-size objects carved out of an arena a chunk at a time, freed ones are
+// reused before the chunk moves on. Chunks are cache line aligned and hold
+// nothing else, so small objects stay packed together instead of between large pushes.
+// Everything lives in the arena, popping it below a chunk invalidates the pool.
+#define ARENA_POOL_CHUNK_SIZE KiB(4)
+
+typedef struct mem_pool_node {
+    struct mem_pool_node* next;
+} mem_pool_node;
+
+typedef struct {
+    mem_arena* arena;
+    // A multiple of ARENA_ALIGN, the items' alignment
+    u64 item_size;
+
+    mem_pool_node* free_list;
+    u8* chunk_pos;
+    u8* chunk_end;
+} mem_pool;
 
 typedef struct {
     mem_arena* arena;
+    // From arena_get_pos
     u64 start_pos;
 } mem_arena_temp;
 
 mem_arena* arena_create(u64 reserve_size, u64 commit_size);
+mem_arena* arena_create_ex(const mem_arena_desc* desc);
+// Releases every chained block too
 void arena_destroy(mem_arena* arena);
+// Bytes used, counting across chained blocks, what temps and arena_pop_to work with
+u64 arena_get_pos(const mem_arena* arena);
+// NULL when the reservation is used up (and the arena isn't chained) or a commit fails
 void* arena_push(mem_arena* arena, u64 size, b32 non_zero);
+// align is any power of two, the address itself is aligned, not just the offset
+void* arena_push_aligned(mem_arena* arena, u64 size, u64 align, b32 non_zero);
+// arena_push_aligned that records its caller's file and line
+void* arena_push_site(mem_arena* arena, u64 size, u64 align, b32 non_zero, const char* file, u32 line);
 void arena_pop(mem_arena* arena, u64 size);
 void arena_pop_to(mem_arena* arena, u64 pos);
 void arena_clear(mem_arena* arena);
+// Decommits everything past pos in the current block, whatever the threshold
+void arena_trim(mem_arena* arena);
 
 mem_arena_temp arena_temp_begin(mem_arena* arena);
 void arena_temp_end(mem_arena_temp temp);
 
+// Applies to scratch arenas created afterwards, so call it before any thread takes one
+void arena_scratch_configure(const mem_arena_scratch_desc* desc);
+// The first of the calling thread's scratch arenas that isn't in conflicts, created on first use.
+// They're chained, so a push never fails for lack of room, size_hint (bytes, 0 if unknown)
+// only makes a new arena reserve enough for it up front.
+// false with a zeroed temp when every arena conflicts or one couldn't be created.
+b32 arena_scratch_try_get(mem_arena_temp* out, mem_arena** conflicts, u32 num_conflicts, u64 size_hint);
+// Same, but prints what went wrong and aborts instead of failing
+mem_arena_temp arena_scratch_get_ex(mem_arena** conflicts, u32 num_conflicts, u64 size_hint);
 mem_arena_temp arena_scratch_get(mem_arena** conflicts, u32 num_conflicts);
 void arena_scratch_release(mem_arena_temp scratch);
+// Destroys the calling thread's scratch arenas, for threads to call on their way out.
+// Thread locals aren't freed when a thread exits, so without it they'd leak.
+void arena_scratch_thread_release(void);
+
+// Prints the counters and the top push sites to stderr, nothing without ARENA_STATS
+void arena_stats_print(const mem_arena* arena, const char* name);
+// Same for the calling thread's scratch arenas
+void arena_scratch_stats_print(void);
+
+#if ARENA_STATS
+#define ARENA_PUSH(arena, size, align, non_zero) arena_push_site((arena), (size), (align), (non_zero), __FILE__, __LINE__)
+#else
+#define ARENA_PUSH(arena, size, align, non_zero) arena_push_aligned((arena), (size), (align), (non_zero))
+#endif
+
+#define PUSH_STRUCT(arena, T) (T*)ARENA_PUSH((arena), sizeof(T), ARENA_ALIGN, false)
+#define PUSH_STRUCT_NZ(arena, T) (T*)ARENA_PUSH((arena), sizeof(T), ARENA_ALIGN, true)
+#define PUSH_ARRAY(arena, T, n) (T*)ARENA_PUSH((arena), sizeof(T) * (n), ARENA_ALIGN, false)
+#define PUSH_ARRAY_NZ(arena, T, n) (T*)ARENA_PUSH((arena), sizeof(T) * (n), ARENA_ALIGN, true)
+#define PUSH_ARRAY_ALIGNED(arena, T, n, align) (T*)ARENA_PUSH((arena), sizeof(T) * (n), (align), false)
+#define PUSH_ARRAY_ALIGNED_NZ(arena, T, n, align) (T*)ARENA_PUSH((arena), sizeof(T) * (n), (align), true)
+
+void pool_init(mem_pool* pool, mem_arena* arena, u64 item_size);
+// NULL if the arena is out of memory
+void* pool_alloc(mem_pool* pool, b32 non_zero);
+void pool_free(mem_pool* pool, void* item);
 
-#define PUSH_STRUCT(arena, T) (T*)arena_push((arena), sizeof(T), false)
-#define PUSH_STRUCT_NZ(arena, T) (T*)arena_push((arena), sizeof(T), true)
-#define PUSH_ARRAY(arena, T, n) (T*)arena_push((arena), sizeof(T) * (n), false)
-#define PUSH_ARRAY_NZ(arena, T, n) (T*)arena_push((arena), sizeof(T) * (n), true)
+#define POOL_INIT_STRUCT(pool, arena, T) pool_init((pool), (arena), sizeof(T))
+#define POOL_ALLOC_STRUCT(pool, T) (T*)pool_alloc((pool), false)
+#define POOL_ALLOC_STRUCT_NZ(pool, T) (T*)pool_alloc((pool), true)
 
 u32 plat_get_pagesize(void);
 
 void* plat_mem_reserve(u64 size);
+// align is a multiple of the page size
+void* plat_mem_reserve_aligned(u64 size, u64 align);
+// NULL if the huge page pool can't cover size
+void* plat_mem_reserve_hugetlb(u64 size);
+b32 plat_mem_advise_huge_pages(void* ptr, u64 size);
+// Pages of the range that aren't there yet will come from node, false on Windows
+b32 plat_mem_bind_node(void* ptr, u64 size, u32 node);
 b32 plat_mem_commit(void* ptr, u64 size);
 b32 plat_mem_decommit(void* ptr, u64 size);
+// Pages may keep their contents until the OS actually needs them
+b32 plat_mem_decommit_lazy(void* ptr, u64 size);
 b32 plat_mem_release(void* ptr, u64 size);
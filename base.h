@@ -17,6 +17,7 @@ typedef i8 b8;
 typedef i32 b32;
 
 typedef float f32;
+typedef double f64;
 
 #define KiB(n) ((u64)(n) << 10)
 #define MiB(n) ((u64)(n) << 20)
@@ -0,0 +1,27 @@
+#if CPU_X86
+#include <immintrin.h>
+#endif
+
+u32 cpu_get_features(void) {
+    static u32 features = 0;
+    static b32 detected = false;
+
+    if (detected) { return features; }
+
+#if CPU_X86
+    // cpuid + xgetbv under the hood, so OS support for the wider registers is checked too
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2")) { features |= CPU_FEATURE_AVX2; }
+    if (__builtin_cpu_supports("fma")) { features |= CPU_FEATURE_FMA; }
+    if (__builtin_cpu_supports("avx512f")) { features |= CPU_FEATURE_AVX512F; }
+#endif
+
+    detected = true;
+
+    return features;
+}
+
+b32 cpu_has(u32 features) {
+    return (cpu_get_features() & features) == features;
+}
@@ -0,0 +1,16 @@
+// Runtime CPU feature detection, used to pick SIMD kernels once at startup
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_X86 1
+#else
+#define CPU_X86 0
+#endif
+
+typedef enum {
+    CPU_FEATURE_AVX2 = 1 << 0,
+    CPU_FEATURE_FMA = 1 << 1,
+    CPU_FEATURE_AVX512F = 1 << 2,
+} cpu_feature;
+
+u32 cpu_get_features(void);
+b32 cpu_has(u32 features);
@@ -0,0 +1,108 @@
+#if defined(_WIN32)
+
+#include <windows.h>
+
+b32 plat_file_map(file_mapping* mapping, const char* filename, u32 flags) {
+    *mapping = (file_mapping){ 0 };
+
+    HANDLE file = CreateFileA(
+        filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL
+    );
+    if (file == INVALID_HANDLE_VALUE) { return false; }
+
+    LARGE_INTEGER size = { 0 };
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (map == NULL) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* data = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+    if (data == NULL) {
+        CloseHandle(map);
+        CloseHandle(file);
+        return false;
+    }
+
+    if (flags & (FILE_MAP_POPULATE | FILE_MAP_WILLNEED)) {
+        WIN32_MEMORY_RANGE_ENTRY range = { data, (SIZE_T)size.QuadPart };
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+
+    mapping->data = data;
+    mapping->size = (u64)size.QuadPart;
+    mapping->file_handle = file;
+    mapping->map_handle = map;
+
+    return true;
+}
+
+void plat_file_unmap(file_mapping* mapping) {
+    if (mapping->data == NULL) { return; }
+
+    UnmapViewOfFile(mapping->data);
+    CloseHandle(mapping->map_handle);
+    CloseHandle(mapping->file_handle);
+
+    *mapping = (file_mapping){ 0 };
+}
+
+#elif defined(__linux__)
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+b32 plat_file_map(file_mapping* mapping, const char* filename, u32 flags) {
+    *mapping = (file_mapping){ 0 };
+
+    i32 fd = open(filename, O_RDONLY);
+    if (fd < 0) { return false; }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    i32 map_flags = MAP_PRIVATE;
+    if (flags & FILE_MAP_POPULATE) {
+        map_flags |= MAP_POPULATE;
+    }
+
+    void* data = mmap(NULL, (u64)st.st_size, PROT_READ, map_flags, fd, 0);
+
+    // The mapping keeps its own reference to the file
+    close(fd);
+
+    if (data == MAP_FAILED) { return false; }
+
+    if (flags & FILE_MAP_WILLNEED) {
+        madvise(data, (u64)st.st_size, MADV_WILLNEED);
+    }
+    if (flags & FILE_MAP_SEQUENTIAL) {
+        madvise(data, (u64)st.st_size, MADV_SEQUENTIAL);
+    }
+
+    mapping->data = data;
+    mapping->size = (u64)st.st_size;
+
+    return true;
+}
+
+void plat_file_unmap(file_mapping* mapping) {
+    if (mapping->data == NULL) { return; }
+
+    munmap(mapping->data, mapping->size);
+
+    *mapping = (file_mapping){ 0 };
+}
+
+#endif
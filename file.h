@@ -0,0 +1,27 @@
+// Read-only file mappings
+//
+// Mapped files share the page cache, so every process reading the same
+// dataset uses one copy of it and nothing is copied on load.
+
+typedef enum {
+    FILE_MAP_NONE = 0,
+
+    // Fault every page in before returning (MAP_POPULATE)
+    FILE_MAP_POPULATE = (1 << 0),
+    // Start asynchronous readahead of the whole file (MADV_WILLNEED)
+    FILE_MAP_WILLNEED = (1 << 1),
+    // Aggressive readahead, pages behind the reader can be dropped early (MADV_SEQUENTIAL)
+    FILE_MAP_SEQUENTIAL = (1 << 2),
+} file_map_flags;
+
+typedef struct {
+    void* data;
+    u64 size;
+
+    // Platform handles kept for unmapping
+    void* file_handle;
+    void* map_handle;
+} file_mapping;
+
+b32 plat_file_map(file_mapping* mapping, const char* filename, u32 flags);
+void plat_file_unmap(file_mapping* mapping);
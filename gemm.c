@@ -0,0 +1,433 @@
+// Packs an mc x kc block of A into mr row micro-panels, zero padding the last one
+static void gemm_pack_a(f32* dst, gemm_operand a, u64 i0, u64 p0, u64 mc, u64 kc, u64 mr) {
+    for (u64 ir = 0; ir < mc; ir += mr) {
+        u64 rows = MIN(mr, mc - ir);
+
+        for (u64 p = 0; p < kc; p++) {
+            const f32* src = a.data + (i0 + ir) * a.row_stride + (p0 + p) * a.col_stride;
+
+            for (u64 i = 0; i < rows; i++) {
+                dst[p * mr + i] = src[i * a.row_stride];
+            }
+            for (u64 i = rows; i < mr; i++) {
+                dst[p * mr + i] = 0.0f;
+            }
+        }
+
+        dst += mr * kc;
+    }
+}
+
+// Packs a kc x nc block of B into nr column micro-panels, zero padding the last one
+static void gemm_pack_b(f32* dst, gemm_operand b, u64 p0, u64 j0, u64 kc, u64 nc, u64 nr) {
+    for (u64 jr = 0; jr < nc; jr += nr) {
+        u64 cols = MIN(nr, nc - jr);
+
+        for (u64 p = 0; p < kc; p++) {
+            const f32* src = b.data + (p0 + p) * b.row_stride + (j0 + jr) * b.col_stride;
+
+            for (u64 j = 0; j < cols; j++) {
+                dst[p * nr + j] = src[j * b.col_stride];
+            }
+            for (u64 j = cols; j < nr; j++) {
+                dst[p * nr + j] = 0.0f;
+            }
+        }
+
+        dst += nr * kc;
+    }
+}
+
+#define GEMM_SCALAR_MR 4
+#define GEMM_SCALAR_NR 16
+
+// Accumulates over k in the same order as a naive triple loop,
+// so results match it bit for bit
+static void gemm_kernel_scalar(u64 kc, const f32* a, const f32* b, f32* c, u64 ldc) {
+    f32 acc[GEMM_SCALAR_MR][GEMM_SCALAR_NR];
+
+    for (u64 i = 0; i < GEMM_SCALAR_MR; i++) {
+        for (u64 j = 0; j < GEMM_SCALAR_NR; j++) {
+            acc[i][j] = c[i * ldc + j];
+        }
+    }
+
+    for (u64 p = 0; p < kc; p++) {
+        for (u64 i = 0; i < GEMM_SCALAR_MR; i++) {
+            f32 a_ip = a[p * GEMM_SCALAR_MR + i];
+
+            for (u64 j = 0; j < GEMM_SCALAR_NR; j++) {
+                acc[i][j] += a_ip * b[p * GEMM_SCALAR_NR + j];
+            }
+        }
+    }
+
+    for (u64 i = 0; i < GEMM_SCALAR_MR; i++) {
+        for (u64 j = 0; j < GEMM_SCALAR_NR; j++) {
+            c[i * ldc + j] = acc[i][j];
+        }
+    }
+}
+
+#if CPU_X86
+
+// 6x16 tile: 12 ymm accumulators, 2 for the B row and 1 broadcast of A
+__attribute__((target("avx2,fma")))
+static void gemm_kernel_avx2(u64 kc, const f32* a, const f32* b, f32* c, u64 ldc) {
+    #define GEMM_AVX2_ROW(i) \
+        __m256 c##i##0 = _mm256_loadu_ps(c + (i) * ldc); \
+        __m256 c##i##1 = _mm256_loadu_ps(c + (i) * ldc + 8);
+
+    GEMM_AVX2_ROW(0) GEMM_AVX2_ROW(1) GEMM_AVX2_ROW(2)
+    GEMM_AVX2_ROW(3) GEMM_AVX2_ROW(4) GEMM_AVX2_ROW(5)
+
+    #undef GEMM_AVX2_ROW
+
+    for (u64 p = 0; p < kc; p++) {
+        __m256 b0 = _mm256_loadu_ps(b);
+        __m256 b1 = _mm256_loadu_ps(b + 8);
+
+        #define GEMM_AVX2_FMA(i) { \
+            __m256 a_i = _mm256_broadcast_ss(a + (i)); \
+            c##i##0 = _mm256_fmadd_ps(a_i, b0, c##i##0); \
+            c##i##1 = _mm256_fmadd_ps(a_i, b1, c##i##1); \
+        }
+
+        GEMM_AVX2_FMA(0) GEMM_AVX2_FMA(1) GEMM_AVX2_FMA(2)
+        GEMM_AVX2_FMA(3) GEMM_AVX2_FMA(4) GEMM_AVX2_FMA(5)
+
+        #undef GEMM_AVX2_FMA
+
+        a += 6;
+        b += 16;
+    }
+
+    #define GEMM_AVX2_STORE(i) \
+        _mm256_storeu_ps(c + (i) * ldc, c##i##0); \
+        _mm256_storeu_ps(c + (i) * ldc + 8, c##i##1);
+
+    GEMM_AVX2_STORE(0) GEMM_AVX2_STORE(1) GEMM_AVX2_STORE(2)
+    GEMM_AVX2_STORE(3) GEMM_AVX2_STORE(4) GEMM_AVX2_STORE(5)
+
+    #undef GEMM_AVX2_STORE
+}
+
+// 14x32 tile: 28 zmm accumulators, 2 for the B row and 1 broadcast of A
+__attribute__((target("avx512f")))
+static void gemm_kernel_avx512(u64 kc, const f32* a, const f32* b, f32* c, u64 ldc) {
+    #define GEMM_AVX512_ROW(i) \
+        __m512 c##i##0 = _mm512_loadu_ps(c + (i) * ldc); \
+        __m512 c##i##1 = _mm512_loadu_ps(c + (i) * ldc + 16);
+
+    GEMM_AVX512_ROW(0) GEMM_AVX512_ROW(1) GEMM_AVX512_ROW(2) GEMM_AVX512_ROW(3)
+    GEMM_AVX512_ROW(4) GEMM_AVX512_ROW(5) GEMM_AVX512_ROW(6) GEMM_AVX512_ROW(7)
+    GEMM_AVX512_ROW(8) GEMM_AVX512_ROW(9) GEMM_AVX512_ROW(10) GEMM_AVX512_ROW(11)
+    GEMM_AVX512_ROW(12) GEMM_AVX512_ROW(13)
+
+    #undef GEMM_AVX512_ROW
+
+    for (u64 p = 0; p < kc; p++) {
+        __m512 b0 = _mm512_loadu_ps(b);
+        __m512 b1 = _mm512_loadu_ps(b + 16);
+
+        #define GEMM_AVX512_FMA(i) { \
+            __m512 a_i = _mm512_set1_ps(a[i]); \
+            c##i##0 = _mm512_fmadd_ps(a_i, b0, c##i##0); \
+            c##i##1 = _mm512_fmadd_ps(a_i, b1, c##i##1); \
+        }
+
+        GEMM_AVX512_FMA(0) GEMM_AVX512_FMA(1) GEMM_AVX512_FMA(2) GEMM_AVX512_FMA(3)
+        GEMM_AVX512_FMA(4) GEMM_AVX512_FMA(5) GEMM_AVX512_FMA(6) GEMM_AVX512_FMA(7)
+        GEMM_AVX512_FMA(8) GEMM_AVX512_FMA(9) GEMM_AVX512_FMA(10) GEMM_AVX512_FMA(11)
+        GEMM_AVX512_FMA(12) GEMM_AVX512_FMA(13)
+
+        #undef GEMM_AVX512_FMA
+
+        a += 14;
+        b += 32;
+    }
+
+    #define GEMM_AVX512_STORE(i) \
+        _mm512_storeu_ps(c + (i) * ldc, c##i##0); \
+        _mm512_storeu_ps(c + (i) * ldc + 16, c##i##1);
+
+    GEMM_AVX512_STORE(0) GEMM_AVX512_STORE(1) GEMM_AVX512_STORE(2) GEMM_AVX512_STORE(3)
+    GEMM_AVX512_STORE(4) GEMM_AVX512_STORE(5) GEMM_AVX512_STORE(6) GEMM_AVX512_STORE(7)
+    GEMM_AVX512_STORE(8) GEMM_AVX512_STORE(9) GEMM_AVX512_STORE(10) GEMM_AVX512_STORE(11)
+    GEMM_AVX512_STORE(12) GEMM_AVX512_STORE(13)
+
+    #undef GEMM_AVX512_STORE
+}
+
+#endif // CPU_X86
+
+static const gemm_kernel_desc _gemm_kernels[GEMM_KERNEL_COUNT] = {
+    [GEMM_KERNEL_SCALAR] = { "scalar", gemm_kernel_scalar, GEMM_SCALAR_MR, GEMM_SCALAR_NR, 128 },
+#if CPU_X86
+    [GEMM_KERNEL_AVX2] = { "avx2", gemm_kernel_avx2, 6, 16, 144 },
+    [GEMM_KERNEL_AVX512] = { "avx512", gemm_kernel_avx512, 14, 32, 112 },
+#endif
+};
+
+static const gemm_kernel_desc* _gemm_kernel = NULL;
+
+void gemm_init(void) {
+    gemm_set_threads(plat_get_core_count());
+
+    if (cpu_has(CPU_FEATURE_AVX512F)) {
+        gemm_set_kernel(GEMM_KERNEL_AVX512);
+    } else if (cpu_has(CPU_FEATURE_AVX2 | CPU_FEATURE_FMA)) {
+        gemm_set_kernel(GEMM_KERNEL_AVX2);
+    } else {
+        gemm_set_kernel(GEMM_KERNEL_SCALAR);
+    }
+}
+
+b32 gemm_set_kernel(gemm_kernel_type type) {
+    if (type >= GEMM_KERNEL_COUNT || _gemm_kernels[type].fn == NULL) {
+        return false;
+    }
+
+    switch (type) {
+        case GEMM_KERNEL_AVX2: {
+            if (!cpu_has(CPU_FEATURE_AVX2 | CPU_FEATURE_FMA)) { return false; }
+        } break;
+        case GEMM_KERNEL_AVX512: {
+            if (!cpu_has(CPU_FEATURE_AVX512F)) { return false; }
+        } break;
+        default: break;
+    }
+
+    _gemm_kernel = &_gemm_kernels[type];
+
+    return true;
+}
+
+const gemm_kernel_desc* gemm_get_kernel(void) {
+    if (_gemm_kernel == NULL) {
+        gemm_init();
+    }
+
+    return _gemm_kernel;
+}
+
+// Edge tiles go through a full sized buffer so the kernels never need bounds
+static void gemm_kernel_edge(
+    const gemm_kernel_desc* kernel, u64 kc, const f32* a, const f32* b,
+    f32* c, u64 ldc, u64 rows, u64 cols
+) {
+    f32 tile[GEMM_MR_MAX * GEMM_NR_MAX] = { 0 };
+    u64 nr = kernel->nr;
+
+    for (u64 i = 0; i < rows; i++) {
+        memcpy(tile + i * nr, c + i * ldc, sizeof(f32) * cols);
+    }
+
+    kernel->fn(kc, a, b, tile, nr);
+
+    for (u64 i = 0; i < rows; i++) {
+        memcpy(c + i * ldc, tile + i * nr, sizeof(f32) * cols);
+    }
+}
+
+// Runs on a rows x cols tile of C starting at (i0, j0) right after its last
+// k block is stored, while the tile is still in L1
+static void gemm_apply_epilogue(
+    const gemm_epilogue* epilogue, f32* c, u64 ldc, u64 i0, u64 j0, u64 rows, u64 cols
+) {
+    for (u64 i = 0; i < rows; i++) {
+        f32* row = c + i * ldc;
+
+        if (epilogue->bias != NULL) {
+            const f32* bias = epilogue->bias + j0;
+
+            for (u64 j = 0; j < cols; j++) {
+                row[j] += bias[j];
+            }
+        }
+
+        if (epilogue->relu) {
+            for (u64 j = 0; j < cols; j++) {
+                row[j] = MAX(0.0f, row[j]);
+            }
+        }
+
+        if (epilogue->relu_mask != NULL) {
+            const f32* mask = epilogue->relu_mask + (i0 + i) * epilogue->ld_relu_mask + j0;
+
+            for (u64 j = 0; j < cols; j++) {
+                row[j] = mask[j] > 0.0f ? row[j] : 0.0f;
+            }
+        }
+    }
+}
+
+// Computes rows [i0, i1) and columns [j0, j1) of C, packing into this thread's scratch arena
+static void gemm_block(
+    const gemm_kernel_desc* kernel, u64 i0, u64 i1, u64 j0, u64 j1, u64 k,
+    gemm_operand a, gemm_operand b, f32* c, u64 ldc, const gemm_epilogue* epilogue
+) {
+    u64 mr = kernel->mr;
+    u64 nr = kernel->nr;
+    u64 mc_max = kernel->mc;
+
+    u64 a_size = (MIN(i1 - i0, mc_max) + mr - 1) / mr * mr * MIN(k, GEMM_KC);
+    u64 b_size = (MIN(j1 - j0, GEMM_NC) + nr - 1) / nr * nr * MIN(k, GEMM_KC);
+
+    u64 size_hint = sizeof(f32) * (a_size + b_size) + 2 * ARENA_SIMD_ALIGN;
+    mem_arena_temp scratch = arena_scratch_get_ex(NULL, 0, size_hint);
+
+    f32* a_pack = PUSH_ARRAY_ALIGNED_NZ(scratch.arena, f32, a_size, ARENA_SIMD_ALIGN);
+    f32* b_pack = PUSH_ARRAY_ALIGNED_NZ(scratch.arena, f32, b_size, ARENA_SIMD_ALIGN);
+
+    for (u64 jc = j0; jc < j1; jc += GEMM_NC) {
+        u64 nc = MIN(GEMM_NC, j1 - jc);
+
+        for (u64 pc = 0; pc < k; pc += GEMM_KC) {
+            u64 kc = MIN(GEMM_KC, k - pc);
+            b32 last_kc = pc + kc == k;
+
+            gemm_pack_b(b_pack, b, pc, jc, kc, nc, nr);
+
+            for (u64 ic = i0; ic < i1; ic += mc_max) {
+                u64 mc = MIN(mc_max, i1 - ic);
+
+                gemm_pack_a(a_pack, a, ic, pc, mc, kc, mr);
+
+                for (u64 jr = 0; jr < nc; jr += nr) {
+                    u64 cols = MIN(nr, nc - jr);
+
+                    for (u64 ir = 0; ir < mc; ir += mr) {
+                        u64 rows = MIN(mr, mc - ir);
+
+                        const f32* a_panel = a_pack + ir * kc;
+                        const f32* b_panel = b_pack + jr * kc;
+                        f32* c_tile = c + (ic + ir) * ldc + jc + jr;
+
+                        if (rows == mr && cols == nr) {
+                            kernel->fn(kc, a_panel, b_panel, c_tile, ldc);
+                        } else {
+                            gemm_kernel_edge(kernel, kc, a_panel, b_panel, c_tile, ldc, rows, cols);
+                        }
+
+                        if (last_kc && epilogue != NULL) {
+                            gemm_apply_epilogue(epilogue, c_tile, ldc, ic + ir, jc + jr, rows, cols);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    arena_scratch_release(scratch);
+}
+
+typedef struct {
+    const gemm_kernel_desc* kernel;
+
+    u64 m, n, k;
+    gemm_operand a, b;
+    f32* c;
+    u64 ldc;
+    const gemm_epilogue* epilogue;
+
+    u64 tile_m, tile_n;
+    u64 tiles_n;
+} gemm_job;
+
+static void gemm_task(void* ctx, u64 task, u32 worker) {
+    (void)worker;
+
+    gemm_job* job = (gemm_job*)ctx;
+
+    u64 i0 = (task / job->tiles_n) * job->tile_m;
+    u64 j0 = (task % job->tiles_n) * job->tile_n;
+    u64 i1 = MIN(i0 + job->tile_m, job->m);
+    u64 j1 = MIN(j0 + job->tile_n, job->n);
+
+    gemm_block(
+        job->kernel, i0, i1, j0, j1, job->k,
+        job->a, job->b, job->c, job->ldc, job->epilogue
+    );
+}
+
+static thread_pool* _gemm_pool = NULL;
+
+void gemm_set_threads(u32 num_threads) {
+    num_threads = MAX(num_threads, 1);
+
+    if (_gemm_pool != NULL) {
+        if (thread_pool_size(_gemm_pool) == num_threads) { return; }
+
+        thread_pool_destroy(_gemm_pool);
+        _gemm_pool = NULL;
+    }
+
+    if (num_threads > 1) {
+        _gemm_pool = thread_pool_create(num_threads);
+    }
+}
+
+u32 gemm_get_threads(void) {
+    return _gemm_pool == NULL ? 1 : thread_pool_size(_gemm_pool);
+}
+
+// Tiles are numbered row-major and every worker starts on a contiguous range of
+// them, so worker w computes about rows [m * w / T, m * (w + 1) / T)
+void gemm_first_touch(void* data, u64 m, u64 row_size) {
+    if (_gemm_pool == NULL) { return; }
+
+    thread_pool_first_touch(_gemm_pool, data, m, row_size);
+}
+
+void gemm_f32(u64 m, u64 n, u64 k, gemm_operand a, gemm_operand b, f32* c, u64 ldc) {
+    gemm_f32_ex(m, n, k, a, b, c, ldc, NULL);
+}
+
+void gemm_f32_ex(
+    u64 m, u64 n, u64 k, gemm_operand a, gemm_operand b,
+    f32* c, u64 ldc, const gemm_epilogue* epilogue
+) {
+    if (m == 0 || n == 0) { return; }
+
+    if (k == 0) {
+        if (epilogue != NULL) {
+            gemm_apply_epilogue(epilogue, c, ldc, 0, 0, m, n);
+        }
+        return;
+    }
+
+    const gemm_kernel_desc* kernel = gemm_get_kernel();
+    u32 num_threads = gemm_get_threads();
+
+    if (num_threads == 1) {
+        gemm_block(kernel, 0, m, 0, n, k, a, b, c, ldc, epilogue);
+        return;
+    }
+
+    // A few tiles per thread leaves room for stealing.
+    // Rows are split first so each tile packs its B panels once;
+    // columns are only split when there aren't enough row blocks.
+    u64 target = (u64)num_threads * GEMM_TILES_PER_THREAD;
+
+    u64 m_blocks = (m + kernel->mc - 1) / kernel->mc;
+    u64 n_blocks = (n + kernel->nr - 1) / kernel->nr;
+
+    u64 tiles_m = MIN(m_blocks, target);
+    u64 tiles_n = MIN(n_blocks, (target + tiles_m - 1) / tiles_m);
+
+    gemm_job job = {
+        .kernel = kernel,
+        .m = m, .n = n, .k = k,
+        .a = a, .b = b,
+        .c = c, .ldc = ldc,
+        .epilogue = epilogue,
+        .tile_m = (m_blocks + tiles_m - 1) / tiles_m * kernel->mc,
+        .tile_n = (n_blocks + tiles_n - 1) / tiles_n * kernel->nr,
+    };
+
+    job.tiles_n = (n + job.tile_n - 1) / job.tile_n;
+    u64 num_tasks = (m + job.tile_m - 1) / job.tile_m * job.tiles_n;
+
+    thread_pool_run(_gemm_pool, gemm_task, &job, num_tasks);
+}
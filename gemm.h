@@ -0,0 +1,80 @@
+// Packed, cache-blocked single precision GEMM (C += A * B)
+//
+// A is m x k, B is k x n and C is m x n with a row stride of ldc.
+// Element (i, j) of an operand lives at data[i * row_stride + j * col_stride],
+// so all four transpose combinations of mul_matrix share the same driver.
+
+// Block sizes, in elements
+// KC x NR panel of B stays in L1, MC x KC block of A in L2, KC x NC block of B in L3
+#define GEMM_KC 256
+#define GEMM_NC 4096
+
+// Output tiles handed to each thread, extra ones are there to be stolen
+#define GEMM_TILES_PER_THREAD 4
+
+// Largest register tile of any micro-kernel, sizes the edge tile buffer
+#define GEMM_MR_MAX 14
+#define GEMM_NR_MAX 32
+
+typedef struct {
+    const f32* data;
+    u64 row_stride;
+    u64 col_stride;
+} gemm_operand;
+
+// Work done on each tile of C once its product is complete,
+// so a dense layer doesn't need extra passes over the output.
+// Applied in field order, NULL/false entries are skipped.
+typedef struct {
+    // n entries, added to every row
+    const f32* bias;
+    // max(0, x)
+    b32 relu;
+    // m x n with row stride ld_relu_mask, zeroes C wherever the mask is <= 0
+    // (the ReLU derivative when the mask is the layer's activation)
+    const f32* relu_mask;
+    u64 ld_relu_mask;
+} gemm_epilogue;
+
+typedef enum {
+    GEMM_KERNEL_SCALAR,
+    GEMM_KERNEL_AVX2,
+    GEMM_KERNEL_AVX512,
+
+    GEMM_KERNEL_COUNT
+} gemm_kernel_type;
+
+// Computes a full mr x nr tile of C from packed panels of A and B
+typedef void (gemm_kernel_fn)(u64 kc, const f32* a, const f32* b, f32* c, u64 ldc);
+
+typedef struct {
+    const char* name;
+    gemm_kernel_fn* fn;
+
+    // Register tile
+    u32 mr, nr;
+    // Rows of A packed per block, a multiple of mr
+    u32 mc;
+} gemm_kernel_desc;
+
+// Picks the fastest micro-kernel the CPU supports and starts one thread per core,
+// called once at startup
+void gemm_init(void);
+
+// Number of threads mul_matrix runs on, including the calling one
+void gemm_set_threads(u32 num_threads);
+u32 gemm_get_threads(void);
+
+// Faults in the pages of an m x row_size (in bytes) A or C operand from the threads
+// that will work on each row, see thread_pool_first_touch
+void gemm_first_touch(void* data, u64 m, u64 row_size);
+
+// Forces a kernel, GEMM_KERNEL_SCALAR gives results identical to a naive triple loop
+b32 gemm_set_kernel(gemm_kernel_type type);
+const gemm_kernel_desc* gemm_get_kernel(void);
+
+void gemm_f32(u64 m, u64 n, u64 k, gemm_operand a, gemm_operand b, f32* c, u64 ldc);
+void gemm_f32_ex(
+    u64 m, u64 n, u64 k, gemm_operand a, gemm_operand b,
+    f32* c, u64 ldc, const gemm_epilogue* epilogue
+);
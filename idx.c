@@ -0,0 +1,152 @@
+static u32 idx_read_u32_be(const u8* p) {
+    return (u32)p[0] << 24 | (u32)p[1] << 16 | (u32)p[2] << 8 | p[3];
+}
+
+u32 idx_type_size(idx_type type) {
+    switch (type) {
+        case IDX_TYPE_U8:
+        case IDX_TYPE_I8: return 1;
+        case IDX_TYPE_I16: return 2;
+        case IDX_TYPE_I32:
+        case IDX_TYPE_F32: return 4;
+        case IDX_TYPE_F64: return 8;
+    }
+
+    return 0;
+}
+
+static b32 idx_parse(idx_file* idx, const u8* data, u64 size, const char* filename) {
+    if (size < 4 || data[0] != 0 || data[1] != 0) {
+        fprintf(stderr, "%s is not an IDX file\n", filename);
+        return false;
+    }
+
+    idx->type = (idx_type)data[2];
+    idx->num_dims = data[3];
+
+    u32 type_size = idx_type_size(idx->type);
+    if (type_size == 0) {
+        fprintf(stderr, "%s has unknown IDX type 0x%02x\n", filename, data[2]);
+        return false;
+    }
+    if (idx->num_dims == 0 || idx->num_dims > IDX_MAX_DIMS) {
+        fprintf(stderr, "%s has %u dimensions, at most %u are supported\n", filename, idx->num_dims, IDX_MAX_DIMS);
+        return false;
+    }
+
+    u64 header_size = 4 + 4 * (u64)idx->num_dims;
+    if (size < header_size) {
+        fprintf(stderr, "%s is truncated\n", filename);
+        return false;
+    }
+
+    idx->count = 1;
+    for (u32 i = 0; i < idx->num_dims; i++) {
+        idx->dims[i] = idx_read_u32_be(data + 4 + 4 * i);
+
+        // Every dimension is under 2^32, so this can only wrap after 2^32 elements
+        if (idx->dims[i] != 0 && idx->count > UINT64_MAX / 2 / idx->dims[i] / type_size) {
+            fprintf(stderr, "%s is too large\n", filename);
+            return false;
+        }
+        idx->count *= idx->dims[i];
+    }
+
+    if (size - header_size < idx->count * type_size) {
+        fprintf(stderr, "%s is truncated, expected %llu elements\n", filename, (unsigned long long)idx->count);
+        return false;
+    }
+
+    idx->data = data + header_size;
+
+    return true;
+}
+
+b32 idx_open(mem_arena* arena, idx_file* idx, const char* filename, u32 map_flags) {
+    *idx = (idx_file){ 0 };
+
+    if (plat_file_map(&idx->mapping, filename, map_flags)) {
+        if (!idx_parse(idx, idx->mapping.data, idx->mapping.size, filename)) {
+            idx_close(idx);
+            return false;
+        }
+
+        return true;
+    }
+
+    char gz_filename[1024];
+    if (snprintf(gz_filename, sizeof(gz_filename), "%s.gz", filename) >= (i32)sizeof(gz_filename)) {
+        return false;
+    }
+
+    // The compressed file is read once front to back
+    file_mapping gz;
+    if (!plat_file_map(&gz, gz_filename, FILE_MAP_SEQUENTIAL)) {
+        return false;
+    }
+
+    u64 size = 0;
+    if (!gzip_get_size(gz.data, gz.size, &size)) {
+        fprintf(stderr, "%s is not a gzip file\n", gz_filename);
+        plat_file_unmap(&gz);
+        return false;
+    }
+
+    mem_arena_temp temp = arena_temp_begin(arena);
+    u8* data = PUSH_ARRAY_NZ(arena, u8, size);
+
+    if (data == NULL) {
+        fprintf(stderr, "Out of memory inflating %s\n", gz_filename);
+        plat_file_unmap(&gz);
+        arena_temp_end(temp);
+        *idx = (idx_file){ 0 };
+        return false;
+    }
+
+    b32 ok = gzip_decompress(data, size, gz.data, gz.size);
+    plat_file_unmap(&gz);
+
+    if (!ok) {
+        fprintf(stderr, "%s is corrupt\n", gz_filename);
+    } else {
+        ok = idx_parse(idx, data, size, gz_filename);
+    }
+
+    if (!ok) {
+        arena_temp_end(temp);
+        *idx = (idx_file){ 0 };
+    }
+
+    return ok;
+}
+
+void idx_close(idx_file* idx) {
+    if (idx->mapping.data != NULL) {
+        plat_file_unmap(&idx->mapping);
+        idx->data = NULL;
+    }
+}
+
+void idx_read_f32(const idx_file* idx, f32* out, u64 first, u64 count) {
+    u32 type_size = idx_type_size(idx->type);
+    const u8* p = idx->data + first * type_size;
+
+    for (u64 i = 0; i < count; i++, p += type_size) {
+        switch (idx->type) {
+            case IDX_TYPE_U8: { out[i] = (f32)p[0]; } break;
+            case IDX_TYPE_I8: { out[i] = (f32)(i8)p[0]; } break;
+            case IDX_TYPE_I16: { out[i] = (f32)(i16)((u16)p[0] << 8 | p[1]); } break;
+            case IDX_TYPE_I32: { out[i] = (f32)(i32)idx_read_u32_be(p); } break;
+            case IDX_TYPE_F32: {
+                u32 bits = idx_read_u32_be(p);
+                memcpy(&out[i], &bits, sizeof(f32));
+            } break;
+            case IDX_TYPE_F64: {
+                u64 bits = (u64)idx_read_u32_be(p) << 32 | idx_read_u32_be(p + 4);
+                f64 x;
+                memcpy(&x, &bits, sizeof(f64));
+                out[i] = (f32)x;
+            } break;
+        }
+    }
+}
@@ -0,0 +1,41 @@
+// IDX files, the format MNIST is distributed in
+//
+// A big-endian header (two zero bytes, a type code, the number of dimensions,
+// then every dimension as a u32) followed by the elements in row-major order.
+// Plain files are used straight from a read-only mapping, gzipped ones
+// (the .gz downloads) are inflated into an arena when they're opened.
+
+typedef enum {
+    IDX_TYPE_U8 = 0x08,
+    IDX_TYPE_I8 = 0x09,
+    IDX_TYPE_I16 = 0x0b,
+    IDX_TYPE_I32 = 0x0c,
+    IDX_TYPE_F32 = 0x0d,
+    IDX_TYPE_F64 = 0x0e,
+} idx_type;
+
+#define IDX_MAX_DIMS 8
+
+typedef struct {
+    idx_type type;
+    u32 num_dims;
+    u32 dims[IDX_MAX_DIMS];
+    // Product of dims
+    u64 count;
+
+    // Big-endian elements, in the mapping or the arena
+    const u8* data;
+
+    file_mapping mapping;
+} idx_file;
+
+// Opens filename, or filename.gz if there is no such file, and validates the header.
+// Quietly returns false when neither exists, malformed files are reported on stderr.
+b32 idx_open(mem_arena* arena, idx_file* idx, const char* filename, u32 map_flags);
+// Invalidates idx->data if it pointed into the mapping
+void idx_close(idx_file* idx);
+
+u32 idx_type_size(idx_type type);
+
+// Converts count elements starting at first to f32
+void idx_read_f32(const idx_file* idx, f32* out, u64 first, u64 count);
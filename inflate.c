@@ -0,0 +1,445 @@
+#define INFLATE_MAX_BITS 15
+#define INFLATE_MAX_LITLEN 288
+#define INFLATE_MAX_DIST 30
+#define INFLATE_MAX_CODELEN 19
+
+// Codes up to this long decode with a single table lookup
+#define INFLATE_FAST_BITS 10
+
+typedef struct {
+    // Indexed by the next FAST_BITS bits of input, symbol << 4 | length,
+    // 0 where the code is longer than FAST_BITS or doesn't exist
+    u16 fast[1 << INFLATE_FAST_BITS];
+
+    // Canonical code, number of codes of each length and the symbols sorted by code
+    u16 count[INFLATE_MAX_BITS + 1];
+    u16 symbol[INFLATE_MAX_LITLEN];
+} inflate_huffman;
+
+typedef struct {
+    const u8* in;
+    u64 in_size;
+    u64 in_pos;
+
+    // Bits are consumed from the bottom
+    u64 bit_buf;
+    u32 bit_count;
+
+    u8* out;
+    u64 out_size;
+    u64 out_pos;
+} inflate_state;
+
+static const u16 _inflate_length_base[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const u8 _inflate_length_extra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const u16 _inflate_dist_base[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const u8 _inflate_dist_extra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static const u8 _inflate_codelen_order[INFLATE_MAX_CODELEN] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// Past the end of the input the buffer fills with zeroes,
+// inflate_overrun catches streams that actually used them
+static void inflate_refill(inflate_state* s) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // Whole word at a time, the top bits that don't fit are read again next time
+    if (s->in_pos + 8 <= s->in_size) {
+        u64 word;
+        memcpy(&word, s->in + s->in_pos, sizeof(word));
+
+        s->bit_buf |= word << s->bit_count;
+        s->in_pos += (63 - s->bit_count) >> 3;
+        s->bit_count |= 56;
+
+        return;
+    }
+#endif
+
+    while (s->bit_count <= 56) {
+        u64 byte = s->in_pos < s->in_size ? s->in[s->in_pos] : 0;
+        s->in_pos++;
+
+        s->bit_buf |= byte << s->bit_count;
+        s->bit_count += 8;
+    }
+}
+
+static b32 inflate_overrun(const inflate_state* s) {
+    return s->in_pos - s->bit_count / 8 > s->in_size;
+}
+
+static u32 inflate_bits(inflate_state* s, u32 n) {
+    inflate_refill(s);
+
+    u32 bits = (u32)(s->bit_buf & ((1ull << n) - 1));
+    s->bit_buf >>= n;
+    s->bit_count -= n;
+
+    return bits;
+}
+
+static b32 inflate_build(inflate_huffman* h, const u8* lengths, u32 n) {
+    memset(h->count, 0, sizeof(h->count));
+    for (u32 i = 0; i < n; i++) {
+        h->count[lengths[i]]++;
+    }
+    h->count[0] = 0;
+
+    // Over-subscribed codes are invalid, incomplete ones are allowed
+    // (a distance code with a single symbol is)
+    i32 left = 1;
+    for (u32 len = 1; len <= INFLATE_MAX_BITS; len++) {
+        left = (left << 1) - h->count[len];
+        if (left < 0) { return false; }
+    }
+
+    u16 offsets[INFLATE_MAX_BITS + 1];
+    offsets[1] = 0;
+    for (u32 len = 1; len < INFLATE_MAX_BITS; len++) {
+        offsets[len + 1] = offsets[len] + h->count[len];
+    }
+    for (u32 i = 0; i < n; i++) {
+        if (lengths[i] != 0) {
+            h->symbol[offsets[lengths[i]]++] = (u16)i;
+        }
+    }
+
+    memset(h->fast, 0, sizeof(h->fast));
+
+    // Codes are stored bit reversed, so each short code fills every
+    // table slot whose low bits match it
+    u32 code = 0;
+    u32 index = 0;
+    for (u32 len = 1; len <= INFLATE_FAST_BITS; len++) {
+        for (u32 i = 0; i < h->count[len]; i++) {
+            u32 reversed = 0;
+            for (u32 b = 0; b < len; b++) {
+                reversed |= ((code >> b) & 1) << (len - 1 - b);
+            }
+
+            u16 entry = (u16)(h->symbol[index] << 4 | len);
+            for (u32 slot = reversed; slot < (1u << INFLATE_FAST_BITS); slot += 1u << len) {
+                h->fast[slot] = entry;
+            }
+
+            code++;
+            index++;
+        }
+        code <<= 1;
+    }
+
+    return true;
+}
+
+// Returns the next symbol, or -1 for a code that isn't in the table
+static i32 inflate_decode(inflate_state* s, const inflate_huffman* h) {
+    inflate_refill(s);
+
+    u16 entry = h->fast[s->bit_buf & ((1u << INFLATE_FAST_BITS) - 1)];
+    if (entry != 0) {
+        u32 len = entry & 15;
+        s->bit_buf >>= len;
+        s->bit_count -= len;
+
+        return entry >> 4;
+    }
+
+    // Walk the canonical code one bit at a time
+    i32 code = 0;
+    i32 first = 0;
+    i32 index = 0;
+    for (u32 len = 1; len <= INFLATE_MAX_BITS; len++) {
+        code |= (i32)((s->bit_buf >> (len - 1)) & 1);
+
+        i32 count = h->count[len];
+        if (code - first < count) {
+            s->bit_buf >>= len;
+            s->bit_count -= len;
+
+            return h->symbol[index + code - first];
+        }
+
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+
+    return -1;
+}
+
+static b32 inflate_stored(inflate_state* s) {
+    // Back up to the first whole byte still in the buffer
+    s->in_pos -= s->bit_count / 8;
+    s->bit_buf = 0;
+    s->bit_count = 0;
+
+    if (s->in_pos + 4 > s->in_size) { return false; }
+
+    u32 len = s->in[s->in_pos] | (u32)s->in[s->in_pos + 1] << 8;
+    u32 nlen = s->in[s->in_pos + 2] | (u32)s->in[s->in_pos + 3] << 8;
+    s->in_pos += 4;
+
+    if (len != (~nlen & 0xffff)) { return false; }
+    if (s->in_pos + len > s->in_size || s->out_pos + len > s->out_size) { return false; }
+
+    memcpy(s->out + s->out_pos, s->in + s->in_pos, len);
+    s->in_pos += len;
+    s->out_pos += len;
+
+    return true;
+}
+
+static b32 inflate_codes(inflate_state* state, const inflate_huffman* litlen, const inflate_huffman* dist) {
+    // Works on a copy, the output stores could otherwise alias the state
+    // and force it back to memory after every byte
+    inflate_state local = *state;
+    inflate_state* s = &local;
+    b32 ok = false;
+
+    while (true) {
+        i32 sym = inflate_decode(s, litlen);
+        if (sym < 0) { break; }
+
+        if (sym < 256) {
+            if (s->out_pos >= s->out_size) { break; }
+            s->out[s->out_pos++] = (u8)sym;
+            continue;
+        }
+
+        if (sym == 256) {
+            ok = !inflate_overrun(s);
+            break;
+        }
+
+        sym -= 257;
+        if (sym >= 29) { break; }
+        u32 len = _inflate_length_base[sym] + inflate_bits(s, _inflate_length_extra[sym]);
+
+        sym = inflate_decode(s, dist);
+        if (sym < 0 || sym >= INFLATE_MAX_DIST) { break; }
+        u64 offset = _inflate_dist_base[sym] + inflate_bits(s, _inflate_dist_extra[sym]);
+
+        if (offset > s->out_pos || s->out_pos + len > s->out_size) { break; }
+
+        u8* dst = s->out + s->out_pos;
+        const u8* src = dst - offset;
+
+        if (offset >= 8 && s->out_pos + len + 8 <= s->out_size) {
+            // Eight bytes at a time, overshooting into output that's written next anyway
+            for (u32 i = 0; i < len; i += 8) {
+                memcpy(dst + i, src + i, 8);
+            }
+        } else {
+            // Overlapping copies repeat the last offset bytes, so go byte by byte
+            for (u32 i = 0; i < len; i++) {
+                dst[i] = src[i];
+            }
+        }
+        s->out_pos += len;
+    }
+
+    *state = local;
+
+    return ok;
+}
+
+static b32 inflate_fixed(inflate_state* s) {
+    u8 lengths[INFLATE_MAX_LITLEN];
+    u32 i = 0;
+    for (; i < 144; i++) { lengths[i] = 8; }
+    for (; i < 256; i++) { lengths[i] = 9; }
+    for (; i < 280; i++) { lengths[i] = 7; }
+    for (; i < 288; i++) { lengths[i] = 8; }
+
+    inflate_huffman litlen, dist;
+    inflate_build(&litlen, lengths, INFLATE_MAX_LITLEN);
+
+    for (i = 0; i < INFLATE_MAX_DIST; i++) { lengths[i] = 5; }
+    inflate_build(&dist, lengths, INFLATE_MAX_DIST);
+
+    return inflate_codes(s, &litlen, &dist);
+}
+
+static b32 inflate_dynamic(inflate_state* s) {
+    u32 num_litlen = inflate_bits(s, 5) + 257;
+    u32 num_dist = inflate_bits(s, 5) + 1;
+    u32 num_codelen = inflate_bits(s, 4) + 4;
+
+    if (num_litlen > 286 || num_dist > INFLATE_MAX_DIST) { return false; }
+
+    u8 lengths[INFLATE_MAX_LITLEN + INFLATE_MAX_DIST] = { 0 };
+    for (u32 i = 0; i < num_codelen; i++) {
+        lengths[_inflate_codelen_order[i]] = (u8)inflate_bits(s, 3);
+    }
+
+    inflate_huffman codelen;
+    if (!inflate_build(&codelen, lengths, INFLATE_MAX_CODELEN)) { return false; }
+
+    // Literal/length and distance code lengths form one run-length coded sequence
+    u32 total = num_litlen + num_dist;
+    u32 i = 0;
+    while (i < total) {
+        i32 sym = inflate_decode(s, &codelen);
+        if (sym < 0) { return false; }
+
+        if (sym < 16) {
+            lengths[i++] = (u8)sym;
+            continue;
+        }
+
+        u8 value = 0;
+        u32 repeat = 0;
+        if (sym == 16) {
+            if (i == 0) { return false; }
+            value = lengths[i - 1];
+            repeat = 3 + inflate_bits(s, 2);
+        } else if (sym == 17) {
+            repeat = 3 + inflate_bits(s, 3);
+        } else {
+            repeat = 11 + inflate_bits(s, 7);
+        }
+
+        if (i + repeat > total) { return false; }
+        while (repeat--) {
+            lengths[i++] = value;
+        }
+    }
+
+    // Without an end of block code the stream could never finish
+    if (lengths[256] == 0) { return false; }
+
+    inflate_huffman litlen, dist;
+    if (!inflate_build(&litlen, lengths, num_litlen)) { return false; }
+    if (!inflate_build(&dist, lengths + num_litlen, num_dist)) { return false; }
+
+    return inflate_codes(s, &litlen, &dist);
+}
+
+b32 inflate_raw(u8* out, u64 out_size, u64* written, const u8* in, u64 in_size, u64* consumed) {
+    inflate_state s = {
+        .in = in, .in_size = in_size,
+        .out = out, .out_size = out_size,
+    };
+
+    b32 last = false;
+    while (!last) {
+        last = inflate_bits(&s, 1);
+        u32 type = inflate_bits(&s, 2);
+
+        b32 ok = false;
+        switch (type) {
+            case 0: { ok = inflate_stored(&s); } break;
+            case 1: { ok = inflate_fixed(&s); } break;
+            case 2: { ok = inflate_dynamic(&s); } break;
+            default: break;
+        }
+
+        if (!ok || inflate_overrun(&s)) { return false; }
+    }
+
+    if (written != NULL) { *written = s.out_pos; }
+    if (consumed != NULL) { *consumed = s.in_pos - s.bit_count / 8; }
+
+    return true;
+}
+
+// Slicing by 8: table[k][b] is the CRC of byte b followed by k zero bytes
+u32 crc32_update(u32 crc, const u8* data, u64 size) {
+    u32 table[8][256];
+    for (u32 i = 0; i < 256; i++) {
+        u32 c = i;
+        for (u32 b = 0; b < 8; b++) {
+            c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        }
+        table[0][i] = c;
+    }
+    for (u32 i = 0; i < 256; i++) {
+        for (u32 k = 1; k < 8; k++) {
+            table[k][i] = table[0][table[k - 1][i] & 0xff] ^ (table[k - 1][i] >> 8);
+        }
+    }
+
+    crc = ~crc;
+
+    u64 i = 0;
+    for (; i + 8 <= size; i += 8) {
+        const u8* p = data + i;
+        u32 lo = crc ^ (p[0] | (u32)p[1] << 8 | (u32)p[2] << 16 | (u32)p[3] << 24);
+
+        crc = table[7][lo & 0xff] ^ table[6][(lo >> 8) & 0xff] ^
+              table[5][(lo >> 16) & 0xff] ^ table[4][lo >> 24] ^
+              table[3][p[4]] ^ table[2][p[5]] ^ table[1][p[6]] ^ table[0][p[7]];
+    }
+    for (; i < size; i++) {
+        crc = table[0][(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+static u32 gzip_read_u32_le(const u8* p) {
+    return p[0] | (u32)p[1] << 8 | (u32)p[2] << 16 | (u32)p[3] << 24;
+}
+
+b32 gzip_is_gzip(const u8* in, u64 in_size) {
+    return in_size >= 2 && in[0] == 0x1f && in[1] == 0x8b;
+}
+
+b32 gzip_get_size(const u8* in, u64 in_size, u64* size) {
+    // 10 byte header, at least 2 bytes of deflate stream, 8 byte trailer
+    if (!gzip_is_gzip(in, in_size) || in_size < 20) { return false; }
+
+    *size = gzip_read_u32_le(in + in_size - 4);
+
+    return true;
+}
+
+b32 gzip_decompress(u8* out, u64 out_size, const u8* in, u64 in_size) {
+    if (!gzip_is_gzip(in, in_size) || in_size < 18 || in[2] != 8) { return false; }
+
+    u8 flags = in[3];
+    u64 pos = 10;
+
+    // FEXTRA
+    if (flags & 4) {
+        if (pos + 2 > in_size) { return false; }
+        pos += 2 + (in[pos] | (u32)in[pos + 1] << 8);
+    }
+    // FNAME and FCOMMENT, both zero terminated
+    for (u32 bit = 8; bit <= 16; bit <<= 1) {
+        if (flags & bit) {
+            while (pos < in_size && in[pos] != 0) { pos++; }
+            pos++;
+        }
+    }
+    // FHCRC
+    if (flags & 2) {
+        pos += 2;
+    }
+
+    if (pos + 8 > in_size) { return false; }
+
+    u64 written = 0;
+    u64 consumed = 0;
+    if (!inflate_raw(out, out_size, &written, in + pos, in_size - pos - 8, &consumed)) {
+        return false;
+    }
+    pos += consumed;
+
+    u32 crc = gzip_read_u32_le(in + pos);
+    u32 size = gzip_read_u32_le(in + pos + 4);
+
+    return written == out_size && size == (u32)written && crc == crc32_update(0, out, written);
+}
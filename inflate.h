@@ -0,0 +1,18 @@
+// DEFLATE (RFC 1951) and gzip (RFC 1952) decompression
+//
+// Whole buffers only, the compressed input and the output both sit in memory,
+// which is all the dataset loaders need.
+
+// Decompresses a raw deflate stream into out, fails on corrupt input or if
+// the output doesn't fit. written and consumed may be NULL.
+b32 inflate_raw(u8* out, u64 out_size, u64* written, const u8* in, u64 in_size, u64* consumed);
+
+// True if in starts with the gzip magic bytes
+b32 gzip_is_gzip(const u8* in, u64 in_size);
+// Uncompressed size from the trailer, only correct for files under 4 GiB
+b32 gzip_get_size(const u8* in, u64 in_size, u64* size);
+// Decompresses the first member of a gzip file and checks its CRC32 and length,
+// out_size has to be exactly the uncompressed size
+b32 gzip_decompress(u8* out, u64 out_size, const u8* in, u64 in_size);
+
+u32 crc32_update(u32 crc, const u8* data, u64 size);
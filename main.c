@@ -12,27 +12,107 @@
 #include "base.h"
 #include "arena.h"
 #include "arena.c"
+#include "cpu.h"
+#include "cpu.c"
+#include "thread.h"
+#include "thread.c"
+#include "gemm.h"
+#include "gemm.c"
+#include "vmath.h"
+#include "vmath.c"
+#include "prng.h"
+#include "prng.c"
+#include "timer.h"
+#include "timer.c"
+#include "file.h"
+#include "file.c"
+#include "inflate.h"
+#include "inflate.c"
+#include "idx.h"
+#include "idx.c"
+#include "tensor.h"
+#include "tensor.c"
 
 typedef struct{
   u32 rows, cols;
   f32* data;
 } matrix;
 
+// raw 0-255 pixels, a quarter the size of the f32 images
+typedef struct{
+  u32 rows, cols;
+  u8* data;
+} matrix_u8;
+
+typedef enum{
+  MATRIX_INIT_ZERO,
+  // whatever the arena had there, for data that's overwritten before it's read
+  MATRIX_INIT_UNINIT,
+} matrix_init;
+
 // simple operations
 matrix* create_matrix(mem_arena* arena, u32 rows, u32 cols);
+matrix* create_matrix_init(mem_arena* arena, u32 rows, u32 cols, matrix_init init);
+// just the header, data is pointed somewhere by the caller
+matrix* create_matrix_header(mem_arena* arena, u32 rows, u32 cols);
+// header from a pool instead of next to the data, for long-lived matrices whose headers
+// should stay packed together; not inside a temp of the pool's arena, which would pop its chunk
+matrix* create_matrix_pooled(mem_pool* headers, mem_arena* arena, u32 rows, u32 cols, matrix_init init);
 void clear_matrix(matrix* mat);
 b32 copy_matrix(matrix* dst, matrix* src);
 void fill_matrix(matrix* mat, f32 x);
 void scale_matrix(matrix* mat, f32 scale);
 
 // loading the matrix in
+// raw f32 dumps, the file has to be exactly rows x cols
 matrix* load_matrix(mem_arena* arena, u32 rows, u32 cols, const char* filename);
+// zero-copy: data points straight into a read-only mapping of the file,
+// shared through the page cache with every other process that maps it
+// map_flags are file_map_flags, the mapping lives until the process exits
+matrix* load_matrix_mapped(mem_arena* arena, u32 rows, u32 cols, const char* filename, u32 map_flags);
+matrix_u8* create_matrix_u8(mem_arena* arena, u32 rows, u32 cols, matrix_init init);
+// same as load_matrix_mapped, one byte per entry
+// quiet when the file can't be opened, so callers can fall back to another format
+matrix_u8* load_matrix_u8_mapped(mem_arena* arena, u32 rows, u32 cols, const char* filename, u32 map_flags);
+// out = round(in * 255), clamped to 0-255
+b32 quantize_matrix_u8(matrix_u8* out, const matrix* in);
+// IDX files (plain or .gz), the first dimension becomes the rows and the rest are flattened,
+// quiet like load_matrix_u8_mapped when the file doesn't exist
+// u8 elements only, used in place unless the file is gzipped
+matrix_u8* load_matrix_u8_idx(mem_arena* arena, const char* filename, u32 map_flags);
+// any element type, converted to f32
+matrix* load_matrix_idx(mem_arena* arena, const char* filename);
+// tensor files, the shape comes from the header and the payload checksum is verified,
+// then data points into the mapping, quiet like the IDX loaders when the file doesn't exist
+matrix* load_matrix_tensor(mem_arena* arena, const char* filename, u32 map_flags);
+matrix_u8* load_matrix_u8_tensor(mem_arena* arena, const char* filename, u32 map_flags);
+b32 save_matrix_tensor(const matrix* mat, const char* filename);
+b32 save_matrix_u8_tensor(const matrix_u8* mat, const char* filename);
 
 // arithmetic operators
 b32 add_matrix(matrix* out, const matrix* a, const matrix* b);
 b32 sub_matrix(matrix* out, const matrix* a, const matrix* b);
+// bias is 1 x a->cols, added to every row of a
+b32 add_bias_matrix(matrix* out, const matrix* a, const matrix* bias);
+// row i of out = row indices[i] of src
+b32 gather_rows_matrix(matrix* out, const matrix* src, const u32* indices);
+// row i of out = row indices[i] of src * scale, indices may be NULL for rows 0..out->rows
+b32 gather_rows_u8_matrix(matrix* out, const matrix_u8* src, const u32* indices, f32 scale);
+// indices is rows x 1 class numbers, out is rows x classes, fails on a class out of range
+b32 one_hot_matrix(matrix* out, const matrix* indices);
 b32 mul_matrix(matrix* out, const matrix* a, const matrix* b, b8 zero_output, b8 transpose_a, b8 transpose_b);
 
+// fused work on the product before it leaves the cache, applied in field order
+// out = relu(a*b + bias) for a dense layer forward pass
+// out = (a*b) where relu_mask > 0, else 0, for its backward pass
+typedef struct{
+  const matrix* bias;       // 1 x out->cols, added to every row
+  b8 relu;
+  const matrix* relu_mask;  // same shape as out
+} mat_epilogue;
+
+b32 mul_matrix_epilogue(matrix* out, const matrix* a, const matrix* b, b8 zero_output, b8 transpose_a, b8 transpose_b, const mat_epilogue* epilogue);
+
 // activation functions
 b32 relu_matrix(matrix* out, const matrix* in);
 b32 softmax_matrix(matrix* out, const matrix* in);
@@ -40,40 +120,242 @@ b32 softmax_matrix(matrix* out, const matrix* in);
 // cost function
 b32 cross_entropy_matrix(matrix* out, const matrix* expected_probab, const matrix* actual_probab);
 
+// softmax + cross entropy in one pass over the logits, without materializing the softmax
+// labels is one-hot (same shape as logits) or holds class indices (rows x 1)
+// loss gets one value per sample (rows x 1)
+// grad is optional, same shape as logits, set to (softmax - label) / rows,
+// the gradient of the mean loss over the batch
+b32 softmax_cross_entropy_matrix(matrix* loss, matrix* grad, const matrix* logits, const matrix* labels);
+
 // get the gradient
-b32 grad_relu_add_matrix(matrix* out, const matrix* in);
-b32 grad_softmax_add_matrix(matrix* out, const matrix* softmax_out);
-b32 grad_cross_entropy_add_matrix(matrix* out, const matrix* expected_probab, const matrix* actual_probab);
+// each one adds the gradient of its forward op, given the upstream gradient grad, into out
+b32 grad_relu_add_matrix(matrix* out, const matrix* in, const matrix* grad);
+b32 grad_softmax_add_matrix(matrix* out, const matrix* softmax_out, const matrix* grad);
+// gradient with respect to actual_probab
+b32 grad_cross_entropy_add_matrix(matrix* out, const matrix* expected_probab, const matrix* actual_probab, const matrix* grad);
+// gradient of softmax_cross_entropy_matrix's loss with respect to the logits, grad is rows x 1,
+// false without touching out if a class index is out of range
+b32 grad_softmax_cross_entropy_add_matrix(matrix* out, const matrix* logits, const matrix* labels, const matrix* grad);
+
+// checks the grad_* kernels against finite differences, prints the errors
+b32 check_gradients(mem_arena* arena);
+
+// reverse-mode autodiff
+// every var, its matrices and the programs live in the arena passed at creation,
+// so a whole graph goes away with one arena_temp_end
+typedef enum {
+  MV_FLAG_NONE = 0,
+
+  MV_FLAG_REQUIRES_GRAD = (1 << 0),
+  MV_FLAG_PARAMETER     = (1 << 1),
+  MV_FLAG_INPUT         = (1 << 2),
+  MV_FLAG_OUTPUT        = (1 << 3),
+} model_var_flags;
+
+typedef enum {
+  MV_OP_NULL = 0,   // leaf, an input or a parameter
+
+  // unary
+  MV_OP_RELU,
+  MV_OP_SOFTMAX,
+
+  // binary
+  MV_OP_ADD,
+  MV_OP_SUB,
+  MV_OP_MATMUL,
+  MV_OP_ADD_BIAS,
+  MV_OP_CROSS_ENTROPY,
+  MV_OP_SOFTMAX_CROSS_ENTROPY,
+
+  // ternary
+  MV_OP_DENSE,        // a*b + bias, one gemm with the bias in its epilogue
+  MV_OP_DENSE_RELU,   // relu(a*b + bias), same gemm
+} model_var_op;
+
+#define MODEL_VAR_MAX_INPUTS 3
+#define MV_NUM_INPUTS(op) ((op) == MV_OP_NULL ? 0 : ((op) < MV_OP_ADD ? 1 : ((op) < MV_OP_DENSE ? 2 : 3)))
+
+typedef struct model_var{
+  u32 index;
+  u32 flags;
+
+  // leaves get their data on creation, everything else from model_prog_create
+  matrix* val;
+  matrix* grad;   // NULL unless MV_FLAG_REQUIRES_GRAD
+  b8 grad_live;   // grad holds this sweep's sum, otherwise it's cleared on first use
+  b8 grad_masked; // a dense relu var's grad is already zero wherever its value is
+
+  model_var_op op;
+  struct model_var* inputs[MODEL_VAR_MAX_INPUTS];
+} model_var;
+
+// vars in topological order, inputs before the vars that use them
+typedef struct{
+  model_var** vars;
+  u32 size;
+
+  // memory behind the values and grads of the intermediate vars,
+  // and what it would take with a separate buffer each
+  u64 activation_bytes;
+  u64 unplanned_activation_bytes;
+} model_program;
+
+// vars and their matrix headers come from pools in the arena the first var was
+// created in, so the graph stays packed together away from the weights
+typedef struct{
+  u32 num_vars;
+
+  mem_pool var_pool;
+  mem_pool matrix_pool;
+} model_context;
+
+// NULL when out of memory, on mismatched shapes or when an input is NULL,
+// so calls can be nested and checked once at the end
+model_var* mv_create(mem_arena* arena, model_context* model, u32 rows, u32 cols, u32 flags);
+
+model_var* mv_relu(mem_arena* arena, model_context* model, model_var* in, u32 flags);
+model_var* mv_softmax(mem_arena* arena, model_context* model, model_var* in, u32 flags);
+
+model_var* mv_add(mem_arena* arena, model_context* model, model_var* a, model_var* b, u32 flags);
+model_var* mv_sub(mem_arena* arena, model_context* model, model_var* a, model_var* b, u32 flags);
+model_var* mv_matmul(mem_arena* arena, model_context* model, model_var* a, model_var* b, u32 flags);
+// bias is 1 x a->cols, added to every row of a
+model_var* mv_add_bias(mem_arena* arena, model_context* model, model_var* a, model_var* bias, u32 flags);
+model_var* mv_cross_entropy(mem_arena* arena, model_context* model, model_var* expected_probab, model_var* actual_probab, u32 flags);
+// rows x 1 per-sample loss, labels as in softmax_cross_entropy_matrix
+model_var* mv_softmax_cross_entropy(mem_arena* arena, model_context* model, model_var* logits, model_var* labels, u32 flags);
+// a*w + bias (1 x w->cols), with relu applied on top if asked, as a single gemm pass.
+// the backward pass of a dense layer feeding a relu one masks that layer's grad
+// in the same gemm that produces it
+model_var* mv_dense(mem_arena* arena, model_context* model, model_var* a, model_var* w, model_var* bias, b32 relu, u32 flags);
+
+// also gives memory to every intermediate var that doesn't have any yet
+// with plan_memory, buffers whose lifetimes over the forward and backward sweep
+// don't overlap share one region, and elementwise ops run in place on inputs
+// nothing reads afterwards; intermediate values are then only valid while the
+// program still needs them, vars flagged MV_FLAG_OUTPUT and out_var stay intact
+// an empty program (size 0) if the arena runs out, with nothing given memory
+model_program model_prog_create(mem_arena* arena, model_context* model, model_var* out_var, b32 plan_memory);
+void model_prog_compute(model_program* prog);
+// gradients of the mean of the last var's entries, every grad in the program is reset first
+void model_prog_compute_grads(model_program* prog);
+
+// the network: 784 -> hidden (relu) -> 10, trained on the mean softmax cross entropy
+#define MNIST_MODEL_MAX_PARAMS 4
+#define MNIST_PIXEL_SCALE (1.0f / 255.0f)
+
+typedef struct{
+  model_context ctx;
+
+  model_var* input;    // batch_size x 784
+  model_var* labels;   // batch_size x 10, one-hot
+  model_var* logits;   // batch_size x 10
+  model_var* cost;     // batch_size x 1
+
+  model_var* params[MNIST_MODEL_MAX_PARAMS];
+  u32 num_params;
+
+  model_program train_prog;
+} mnist_model;
+
+typedef struct{
+  u32 epochs;
+  u32 batch_size;
+  f32 learning_rate;
+  u64 seed;
+} training_desc;
+
+// batches being assembled ahead of the one being trained on
+#define TRAIN_PREFETCH_DEPTH 2
+
+typedef struct{
+  matrix* images;  // batch_size x 784
+  matrix* labels;  // batch_size x 10
+} mnist_batch;
+
+mnist_model* create_mnist_model(mem_arena* arena, u32 batch_size, u32 hidden_size, u64 seed);
+// minibatch sgd, prints throughput and test accuracy after every epoch
+// steady state steps don't allocate, the batches and shuffle order are set up front
+// a background thread shuffles and gathers the next batches while the current one trains
+// images are dequantized by 1/255 as each batch is gathered
+// false if the batches couldn't be set up
+b32 train(mem_arena* arena, mnist_model* model, const matrix_u8* train_images, const matrix* train_labels, const matrix_u8* test_images, const matrix* test_labels, const training_desc* desc);
+f32 evaluate_accuracy(mnist_model* model, const matrix_u8* images, const matrix* labels);
+
+// maps the u8 dump if there is one, otherwise quantizes the f32 one,
+// which keeps 47 MB of pixels resident instead of 188 MB
+matrix_u8* load_mnist_images(mem_arena* arena, u32 rows, const char* u8_filename, const char* f32_filename);
+
+typedef struct{
+  matrix_u8* images;  // n x 784
+  matrix* classes;    // n x 1
+  matrix* labels;     // n x 10, one-hot
+} mnist_split;
+
+// in order of preference, the .tns tensor files --pack writes ("train"/"test" prefixes),
+// the original IDX files ("train"/"t10k" prefixes, optionally .gz),
+// or the .mat files mnist.py writes ("train"/"test" prefixes, mat_rows of them)
+b32 load_mnist_split(mem_arena* arena, mnist_split* split, const char* idx_prefix, const char* mat_prefix, u32 mat_rows);
+b32 save_mnist_split(const mnist_split* split, const char* mat_prefix);
 
 // 
 void draw_MNIST_digits(f32* data);
 
-int main() {
-  mem_arena* permanent_arena = arena_create(GiB(1), MiB(1));
+int main(int argc, char** argv) {
+  gemm_init();
+
+  // weights, labels and inflated datasets, on huge pages where the kernel allows it.
+  // chained, so it grows 64 MiB at a time with the dataset instead of reserving for the worst case
+  mem_arena_desc permanent_desc = {
+    .reserve_size = MiB(64),
+    .commit_size = MiB(2),
+    .flags = ARENA_FLAG_HUGE_PAGES | ARENA_FLAG_CHAINED,
+  };
+  mem_arena* permanent_arena = arena_create_ex(&permanent_desc);
+  if (!permanent_arena) {
+    fprintf(stderr, "Failed to reserve memory\n");
+    return 1;
+  }
 
-  matrix* train_images = load_matrix(permanent_arena, 60000, 784, "train_images.mat");
-  matrix* test_images = load_matrix(permanent_arena, 10000, 784, "test_images.mat");
-  matrix* train_labels = create_matrix(permanent_arena, 60000, 10);
-  matrix* test_labels = create_matrix(permanent_arena, 10000, 10);
+  if (argc > 1 && strcmp(argv[1], "--grad-check") == 0) {
+    b32 passed = check_gradients(permanent_arena);
+    arena_destroy(permanent_arena);
 
-  {
-    matrix* train_labels_file = load_matrix(permanent_arena, 60000, 1, "train_labels.mat");
-    matrix* test_labels_file = load_matrix(permanent_arena, 10000, 1,"test_labels.mat");
+    return passed ? 0 : 1;
+  }
 
-    for (u32 i = 0; i < 60000; i++) {
-      u32 num = train_labels_file->data[i];
+  u64 load_start = plat_get_time_ns();
 
-      train_labels->data[i * 10 + num] = 1.0f;
-    }
-    for (u32 i = 0; i < 10000; i++) {
-      u32 num = test_labels_file->data[i];
+  mnist_split train_split, test_split;
+  if (!load_mnist_split(permanent_arena, &train_split, "train", "train", 60000) ||
+      !load_mnist_split(permanent_arena, &test_split, "t10k", "test", 10000)) {
+    arena_destroy(permanent_arena);
+    return 1;
+  }
 
-      test_labels->data[i * 10 + num] = 1.0f;
-    }
+  printf("loaded the dataset in %.3f s\n", (plat_get_time_ns() - load_start) * 1e-9);
+
+  // checked, aligned copies of whatever was loaded, picked up by later runs
+  if (argc > 1 && strcmp(argv[1], "--pack") == 0) {
+    b32 saved = save_mnist_split(&train_split, "train") && save_mnist_split(&test_split, "test");
+    arena_destroy(permanent_arena);
+
+    return saved ? 0 : 1;
   }
 
-  draw_MNIST_digits(&train_images->data[0 * 784]);
-  draw_MNIST_digits(&test_images->data[0 * 784]);
+  matrix_u8* train_images = train_split.images;
+  matrix_u8* test_images = test_split.images;
+  matrix* train_labels = train_split.labels;
+  matrix* test_labels = test_split.labels;
+
+  {
+    f32 digit[784];
+
+    vm_u8_to_f32(digit, &train_images->data[0 * 784], 784, MNIST_PIXEL_SCALE);
+    draw_MNIST_digits(digit);
+    vm_u8_to_f32(digit, &test_images->data[0 * 784], 784, MNIST_PIXEL_SCALE);
+    draw_MNIST_digits(digit);
+  }
 
   for (u32 i = 0; i < 10; i++) {
     printf("%.0f", train_labels->data[i]);
@@ -81,11 +363,156 @@ int main() {
 
   printf("\n");
 
+  training_desc desc = {
+    .epochs = 10,
+    .batch_size = 64,
+    .learning_rate = 0.1f,
+    .seed = 0x853c49e6748fea9bULL,
+  };
+
+  mnist_model* model = create_mnist_model(permanent_arena, desc.batch_size, 128, desc.seed);
+  if (!model) {
+    arena_destroy(permanent_arena);
+    return 1;
+  }
+
+  if (!train(permanent_arena, model, train_images, train_labels, test_images, test_labels, &desc)) {
+    arena_destroy(permanent_arena);
+    return 1;
+  }
+
+  arena_stats_print(permanent_arena, "permanent");
+  arena_scratch_stats_print();
+
   arena_destroy(permanent_arena);
 
   return 0;
 }
 
+matrix_u8* load_mnist_images(mem_arena* arena, u32 rows, const char* u8_filename, const char* f32_filename){
+  matrix_u8* images = load_matrix_u8_mapped(arena, rows, 784, u8_filename, FILE_MAP_WILLNEED);
+  if (images) {
+    return images;
+  }
+
+  // the f32 mapping is only read once, so it's dropped as soon as it's quantized
+  file_mapping mapping;
+  if (!plat_file_map(&mapping, f32_filename, FILE_MAP_SEQUENTIAL)) {
+    fprintf(stderr, "Failed to map %s or %s\n", u8_filename, f32_filename);
+    return NULL;
+  }
+
+  if (mapping.size != sizeof(f32) * (u64)rows * 784) {
+    fprintf(stderr, "%s doesn't hold a %ux%u matrix\n", f32_filename, rows, 784);
+    plat_file_unmap(&mapping);
+    return NULL;
+  }
+
+  matrix src = { .rows = rows, .cols = 784, .data = (f32*)mapping.data };
+
+  images = create_matrix_u8(arena, rows, 784, MATRIX_INIT_UNINIT);
+  if (images) {
+    quantize_matrix_u8(images, &src);
+  }
+
+  plat_file_unmap(&mapping);
+
+  return images;
+}
+
+static b32 _file_exists(const char* filename){
+  FILE* f = fopen(filename, "rb");
+
+  if (f) {
+    fclose(f);
+  }
+
+  return f != NULL;
+}
+
+b32 load_mnist_split(mem_arena* arena, mnist_split* split, const char* idx_prefix, const char* mat_prefix, u32 mat_rows){
+  char images_name[256], labels_name[256];
+  matrix* label_indices = NULL;
+
+  snprintf(images_name, sizeof(images_name), "%s_images.tns", mat_prefix);
+  snprintf(labels_name, sizeof(labels_name), "%s_labels.tns", mat_prefix);
+
+  // a format whose files are there has to load, a corrupt file never falls through to the next one
+  b32 found = false;
+  split->images = NULL;
+
+  if (_file_exists(images_name)) {
+    found = true;
+    split->images = load_matrix_u8_tensor(arena, images_name, FILE_MAP_WILLNEED);
+    label_indices = split->images ? load_matrix_tensor(arena, labels_name, FILE_MAP_NONE) : NULL;
+  } else {
+    char gz_name[sizeof(images_name) + 3];
+
+    snprintf(images_name, sizeof(images_name), "%s-images-idx3-ubyte", idx_prefix);
+    snprintf(labels_name, sizeof(labels_name), "%s-labels-idx1-ubyte", idx_prefix);
+    snprintf(gz_name, sizeof(gz_name), "%s.gz", images_name);
+
+    if (_file_exists(images_name) || _file_exists(gz_name)) {
+      found = true;
+      split->images = load_matrix_u8_idx(arena, images_name, FILE_MAP_WILLNEED);
+      label_indices = split->images ? load_matrix_idx(arena, labels_name) : NULL;
+    }
+  }
+
+  if (found) {
+    if (!split->images || !label_indices) {
+      fprintf(stderr, "Failed to load %s\n", split->images ? labels_name : images_name);
+      return false;
+    }
+  } else {
+    char f32_name[256];
+
+    snprintf(images_name, sizeof(images_name), "%s_images_u8.mat", mat_prefix);
+    snprintf(f32_name, sizeof(f32_name), "%s_images.mat", mat_prefix);
+    snprintf(labels_name, sizeof(labels_name), "%s_labels.mat", mat_prefix);
+
+    split->images = load_mnist_images(arena, mat_rows, images_name, f32_name);
+    label_indices = load_matrix(arena, mat_rows, 1, labels_name);
+
+    if (!split->images || !label_indices) {
+      return false;
+    }
+  }
+
+  if (split->images->cols != 784) {
+    fprintf(stderr, "%s has %u pixels per image, expected 784\n", images_name, split->images->cols);
+    return false;
+  }
+
+  if (label_indices->rows != split->images->rows || label_indices->cols != 1) {
+    fprintf(stderr, "%s doesn't have one label per image\n", labels_name);
+    return false;
+  }
+
+  split->classes = label_indices;
+  split->labels = create_matrix_init(arena, split->images->rows, 10, MATRIX_INIT_UNINIT);
+  if (!split->labels) {
+    fprintf(stderr, "Out of memory for the %s labels\n", mat_prefix);
+    return false;
+  }
+
+  if (!one_hot_matrix(split->labels, label_indices)) {
+    fprintf(stderr, "%s has labels outside 0-9\n", labels_name);
+    return false;
+  }
+
+  return true;
+}
+
+b32 save_mnist_split(const mnist_split* split, const char* mat_prefix){
+  char images_name[256], labels_name[256];
+
+  snprintf(images_name, sizeof(images_name), "%s_images.tns", mat_prefix);
+  snprintf(labels_name, sizeof(labels_name), "%s_labels.tns", mat_prefix);
+
+  return save_matrix_u8_tensor(split->images, images_name) && save_matrix_tensor(split->classes, labels_name);
+}
+
 void draw_MNIST_digits(f32* data){
   for (u32 y = 0; y < 28; y++) {
     for (u32 x = 0; x < 28; x++) {
@@ -100,38 +527,341 @@ void draw_MNIST_digits(f32* data){
   printf("\x1b[0m");
 }
 
+matrix* create_matrix_header(mem_arena* arena, u32 rows, u32 cols){
+  matrix* mat = PUSH_STRUCT(arena, matrix);
+  if (!mat) {
+    return NULL;
+  }
+
+  mat->rows = rows;
+  mat->cols = cols;
+
+  return mat;
+}
+
 matrix* create_matrix(mem_arena* arena, u32 rows, u32 cols){
+  return create_matrix_init(arena, rows, cols, MATRIX_INIT_ZERO);
+}
+
+matrix* create_matrix_init(mem_arena* arena, u32 rows, u32 cols, matrix_init init){
+  mem_arena_temp temp = arena_temp_begin(arena);
   matrix* mat = PUSH_STRUCT(arena, matrix);
+  f32* data = (f32*)ARENA_PUSH(arena, sizeof(f32) * (u64)rows * cols, ARENA_SIMD_ALIGN, init == MATRIX_INIT_UNINIT);
+
+  // a full arena gives NULL, don't leave a header behind pointing at nothing
+  if (!mat || !data) {
+    arena_temp_end(temp);
+    return NULL;
+  }
 
   mat->rows = rows;
   mat->cols= cols;
-  mat->data= PUSH_ARRAY(arena, f32, (u64)rows * cols);
+  mat->data= data;
 
   return mat;
 }
 
-matrix* load_matrix(mem_arena* arena, u32 rows, u32 cols, const char* filename){
-  matrix* mat = create_matrix(arena, rows, cols);
+matrix* create_matrix_pooled(mem_pool* headers, mem_arena* arena, u32 rows, u32 cols, matrix_init init){
+  matrix* mat = POOL_ALLOC_STRUCT(headers, matrix);
+  if (!mat) {
+    return NULL;
+  }
+
+  mat->rows = rows;
+  mat->cols = cols;
+  mat->data = (f32*)ARENA_PUSH(arena, sizeof(f32) * (u64)rows * cols, ARENA_SIMD_ALIGN, init == MATRIX_INIT_UNINIT);
+
+  if (!mat->data) {
+    pool_free(headers, mat);
+    return NULL;
+  }
 
+  return mat;
+}
+
+matrix* load_matrix(mem_arena* arena, u32 rows, u32 cols, const char* filename){
   FILE* f = fopen(filename, "rb");
   if (!f) {
       fprintf(stderr, "Failed to open %s\n", filename);
       return NULL;
   }
 
+  u64 expected = sizeof(f32) * (u64)rows * cols;
+
   fseek(f, 0, SEEK_END);
-  u64 size = ftell(f);
+  i64 size = ftell(f);
   fseek(f, 0, SEEK_SET);
 
-  size = MIN(size, sizeof(f32)*rows*cols);
+  if (size < 0 || (u64)size != expected) {
+    fprintf(stderr, "%s is %lld bytes, a %ux%u matrix needs %llu\n", filename, (long long)size, rows, cols, (unsigned long long)expected);
+    fclose(f);
+    return NULL;
+  }
+
+  mem_arena_temp temp = arena_temp_begin(arena);
+  matrix* mat = create_matrix_init(arena, rows, cols, MATRIX_INIT_UNINIT);
 
-  fread(mat->data, 1, size, f);
+  if (!mat) {
+    fprintf(stderr, "Out of memory for %s\n", filename);
+  } else if (fread(mat->data, 1, expected, f) != expected) {
+    fprintf(stderr, "Failed to read %s\n", filename);
+    arena_temp_end(temp);
+    mat = NULL;
+  }
 
   fclose(f);
 
   return mat;
 }
 
+matrix* load_matrix_mapped(mem_arena* arena, u32 rows, u32 cols, const char* filename, u32 map_flags){
+  file_mapping mapping;
+
+  if (!plat_file_map(&mapping, filename, map_flags)) {
+    fprintf(stderr, "Failed to map %s\n", filename);
+    return NULL;
+  }
+
+  if (mapping.size != sizeof(f32) * (u64)rows * cols) {
+    fprintf(stderr, "%s doesn't hold a %ux%u matrix\n", filename, rows, cols);
+    plat_file_unmap(&mapping);
+    return NULL;
+  }
+
+  matrix* mat = create_matrix_header(arena, rows, cols);
+  if (!mat) {
+    fprintf(stderr, "Out of memory for %s\n", filename);
+    plat_file_unmap(&mapping);
+    return NULL;
+  }
+
+  mat->data = (f32*)mapping.data;
+
+  return mat;
+}
+
+matrix_u8* create_matrix_u8(mem_arena* arena, u32 rows, u32 cols, matrix_init init){
+  mem_arena_temp temp = arena_temp_begin(arena);
+  matrix_u8* mat = PUSH_STRUCT(arena, matrix_u8);
+  u8* data = (u8*)ARENA_PUSH(arena, (u64)rows * cols, ARENA_SIMD_ALIGN, init == MATRIX_INIT_UNINIT);
+
+  if (!mat || !data) {
+    arena_temp_end(temp);
+    return NULL;
+  }
+
+  mat->rows = rows;
+  mat->cols = cols;
+  mat->data = data;
+
+  return mat;
+}
+
+matrix_u8* load_matrix_u8_mapped(mem_arena* arena, u32 rows, u32 cols, const char* filename, u32 map_flags){
+  file_mapping mapping;
+
+  if (!plat_file_map(&mapping, filename, map_flags)) {
+    return NULL;
+  }
+
+  if (mapping.size != (u64)rows * cols) {
+    fprintf(stderr, "%s doesn't hold a %ux%u matrix\n", filename, rows, cols);
+    plat_file_unmap(&mapping);
+    return NULL;
+  }
+
+  matrix_u8* mat = PUSH_STRUCT(arena, matrix_u8);
+  if (!mat) {
+    fprintf(stderr, "Out of memory for %s\n", filename);
+    plat_file_unmap(&mapping);
+    return NULL;
+  }
+
+  mat->rows = rows;
+  mat->cols = cols;
+  mat->data = (u8*)mapping.data;
+
+  return mat;
+}
+
+b32 quantize_matrix_u8(matrix_u8* out, const matrix* in){
+  if (out->rows != in->rows || out->cols != in->cols) {
+    return false;
+  }
+
+  u64 size = (u64)out->rows * out->cols;
+
+  for (u64 i = 0; i < size; i++) {
+    f32 x = in->data[i] * 255.0f + 0.5f;
+
+    out->data[i] = x <= 0.0f ? 0 : (x >= 255.0f ? 255 : (u8)x);
+  }
+
+  return true;
+}
+
+// rows x cols from an opened IDX file, false if the shape doesn't fit a matrix
+static b32 _idx_matrix_shape(const idx_file* idx, const char* filename, u32* rows, u32* cols){
+  u64 inner = 1;
+
+  for (u32 i = 1; i < idx->num_dims; i++) {
+    inner *= idx->dims[i];
+
+    if (inner > UINT32_MAX) {
+      fprintf(stderr, "%s has too many columns for a matrix\n", filename);
+      return false;
+    }
+  }
+
+  *rows = idx->dims[0];
+  *cols = (u32)inner;
+
+  return true;
+}
+
+matrix_u8* load_matrix_u8_idx(mem_arena* arena, const char* filename, u32 map_flags){
+  idx_file idx;
+  u32 rows, cols;
+
+  if (!idx_open(arena, &idx, filename, map_flags)) {
+    return NULL;
+  }
+
+  if (idx.type != IDX_TYPE_U8) {
+    fprintf(stderr, "%s doesn't hold u8 elements\n", filename);
+    idx_close(&idx);
+    return NULL;
+  }
+
+  if (!_idx_matrix_shape(&idx, filename, &rows, &cols)) {
+    idx_close(&idx);
+    return NULL;
+  }
+
+  // a plain file stays mapped for the rest of the process, like load_matrix_u8_mapped
+  matrix_u8* mat = PUSH_STRUCT(arena, matrix_u8);
+  if (!mat) {
+    fprintf(stderr, "Out of memory for %s\n", filename);
+    idx_close(&idx);
+    return NULL;
+  }
+
+  mat->rows = rows;
+  mat->cols = cols;
+  mat->data = (u8*)idx.data;
+
+  return mat;
+}
+
+matrix* load_matrix_idx(mem_arena* arena, const char* filename){
+  idx_file idx;
+  u32 rows, cols;
+
+  if (!idx_open(arena, &idx, filename, FILE_MAP_SEQUENTIAL)) {
+    return NULL;
+  }
+
+  if (!_idx_matrix_shape(&idx, filename, &rows, &cols)) {
+    idx_close(&idx);
+    return NULL;
+  }
+
+  matrix* mat = create_matrix_init(arena, rows, cols, MATRIX_INIT_UNINIT);
+  if (mat) {
+    idx_read_f32(&idx, mat->data, 0, idx.count);
+  }
+
+  idx_close(&idx);
+
+  return mat;
+}
+
+// rows are the first dimension, the rest are flattened into columns
+static const void* _tensor_matrix_open(tensor_file* file, const char* filename, u32 map_flags, tensor_dtype dtype, u32* rows, u32* cols){
+  if (!tensor_file_open(file, filename, map_flags, true)) {
+    return NULL;
+  }
+
+  u64 inner = 1;
+  for (u32 i = 1; i < file->header.num_dims; i++) {
+    inner *= file->header.dims[i];
+  }
+
+  if (file->header.dtype != dtype) {
+    fprintf(stderr, "%s doesn't hold %s elements\n", filename, dtype == TENSOR_DTYPE_U8 ? "u8" : "f32");
+    tensor_file_close(file);
+    return NULL;
+  }
+
+  if (file->header.dims[0] > UINT32_MAX || inner > UINT32_MAX) {
+    fprintf(stderr, "%s is too large for a matrix\n", filename);
+    tensor_file_close(file);
+    return NULL;
+  }
+
+  *rows = (u32)file->header.dims[0];
+  *cols = (u32)inner;
+
+  return file->data;
+}
+
+matrix* load_matrix_tensor(mem_arena* arena, const char* filename, u32 map_flags){
+  tensor_file file;
+  u32 rows, cols;
+
+  const void* data = _tensor_matrix_open(&file, filename, map_flags, TENSOR_DTYPE_F32, &rows, &cols);
+  if (!data) {
+    return NULL;
+  }
+
+  // stays mapped for the rest of the process
+  matrix* mat = create_matrix_header(arena, rows, cols);
+  if (!mat) {
+    fprintf(stderr, "Out of memory for %s\n", filename);
+    tensor_file_close(&file);
+    return NULL;
+  }
+
+  mat->data = (f32*)data;
+
+  return mat;
+}
+
+matrix_u8* load_matrix_u8_tensor(mem_arena* arena, const char* filename, u32 map_flags){
+  tensor_file file;
+  u32 rows, cols;
+
+  const void* data = _tensor_matrix_open(&file, filename, map_flags, TENSOR_DTYPE_U8, &rows, &cols);
+  if (!data) {
+    return NULL;
+  }
+
+  matrix_u8* mat = PUSH_STRUCT(arena, matrix_u8);
+  if (!mat) {
+    fprintf(stderr, "Out of memory for %s\n", filename);
+    tensor_file_close(&file);
+    return NULL;
+  }
+
+  mat->rows = rows;
+  mat->cols = cols;
+  mat->data = (u8*)data;
+
+  return mat;
+}
+
+b32 save_matrix_tensor(const matrix* mat, const char* filename){
+  u64 dims[2] = { mat->rows, mat->cols };
+
+  return tensor_file_write(filename, TENSOR_DTYPE_F32, 2, dims, mat->data);
+}
+
+b32 save_matrix_u8_tensor(const matrix_u8* mat, const char* filename){
+  u64 dims[2] = { mat->rows, mat->cols };
+
+  return tensor_file_write(filename, TENSOR_DTYPE_U8, 2, dims, mat->data);
+}
+
 b32 copy_matrix(matrix* dst, matrix* src){
   if (dst->rows != src->rows || dst->cols != src->cols) {
     return false;
@@ -205,57 +935,121 @@ b32 sub_matrix(matrix* out, const matrix* a, const matrix* b){
   return true;
 }
 
-// n stands for non-transpose
-// t stands for tranpose
-void mat_mul_nn(matrix* out, const matrix* a, const matrix* b){
-    for (u64 i = 0; i < out->rows; i++){
-        for (u64 j = 0; j < out->cols; j++){
-            for (u64 k = 0; k < a->cols; k++){
-                out->data[i*out->cols + j] +=
-                    a->data[i*a->cols + k] *
-                    b->data[k*b->cols + j];
-            }
-        }
-    }
-}
+b32 add_bias_matrix(matrix* out, const matrix* a, const matrix* bias){
+  if (bias->rows != 1 || bias->cols != a->cols) {
+    return false;
+  }
+  if (out->rows != a->rows || out->cols != a->cols) {
+    return false;
+  }
 
-void mat_mul_nt(matrix* out, const matrix* a, const matrix* b){
-    for (u64 i = 0; i < out->rows; i++){
-        for (u64 j = 0; j < out->cols; j++){
-            for (u64 k = 0; k < a->cols; k++){
-                out->data[i*out->cols + j] +=
-                    a->data[i*a->cols + k] *
-                    b->data[j*b->cols + k];
-            }
-        }
+  for (u64 i = 0; i < out->rows; i++) {
+    for (u64 j = 0; j < out->cols; j++) {
+      out->data[i * out->cols + j] = a->data[i * a->cols + j] + bias->data[j];
     }
-}
+  }
 
-void mat_mul_tn(matrix* out, const matrix* a, const matrix* b){
-    for (u64 i = 0; i < out->rows; i++){
-        for (u64 j = 0; j < out->cols; j++){
-            for (u64 k = 0; k < a->rows; k++){
-                out->data[i*out->cols + j] +=
-                    a->data[k*a->cols + i] *
-                    b->data[k*b->cols + j];
-            }
-        }
-    }
+  return true;
 }
 
-void mat_mul_tt(matrix* out, const matrix* a, const matrix* b){
-    for (u64 i = 0; i < out->rows; i++){
-        for (u64 j = 0; j < out->cols; j++){
-            for (u64 k = 0; k < a->rows; k++){
-                out->data[i*out->cols + j] +=
-                    a->data[k*a->cols + i] *
-                    b->data[j*b->cols + k];
-            }
-        }
-    }
+b32 gather_rows_matrix(matrix* out, const matrix* src, const u32* indices){
+  if (out->cols != src->cols) {
+    return false;
+  }
+
+  for (u64 i = 0; i < out->rows; i++) {
+    if (indices[i] >= src->rows) {
+      return false;
+    }
+
+    memcpy(&out->data[i * out->cols], &src->data[(u64)indices[i] * src->cols], sizeof(f32) * out->cols);
+  }
+
+  return true;
+}
+
+b32 gather_rows_u8_matrix(matrix* out, const matrix_u8* src, const u32* indices, f32 scale){
+  if (out->cols != src->cols) {
+    return false;
+  }
+
+  if (!indices) {
+    if (out->rows > src->rows) {
+      return false;
+    }
+
+    vm_u8_to_f32(out->data, src->data, (u64)out->rows * out->cols, scale);
+
+    return true;
+  }
+
+  for (u64 i = 0; i < out->rows; i++) {
+    if (indices[i] >= src->rows) {
+      return false;
+    }
+
+    vm_u8_to_f32(&out->data[i * out->cols], &src->data[(u64)indices[i] * src->cols], out->cols, scale);
+  }
+
+  return true;
+}
+
+b32 one_hot_matrix(matrix* out, const matrix* indices){
+  if (out->rows != indices->rows || indices->cols != 1) {
+    return false;
+  }
+
+  clear_matrix(out);
+
+  for (u64 i = 0; i < out->rows; i++) {
+    f32 num = indices->data[i];
+
+    if (!(num >= 0.0f && num < out->cols)) {
+      return false;
+    }
+
+    out->data[i * out->cols + (u32)num] = 1.0f;
+  }
+
+  return true;
+}
+
+// n stands for non-transpose
+// t stands for tranpose
+// all four go through the packed gemm, only the operand strides differ
+void mat_mul_nn(matrix* out, const matrix* a, const matrix* b, const gemm_epilogue* epilogue){
+    gemm_f32_ex(out->rows, out->cols, a->cols,
+             (gemm_operand){ a->data, a->cols, 1 },
+             (gemm_operand){ b->data, b->cols, 1 },
+             out->data, out->cols, epilogue);
+}
+
+void mat_mul_nt(matrix* out, const matrix* a, const matrix* b, const gemm_epilogue* epilogue){
+    gemm_f32_ex(out->rows, out->cols, a->cols,
+             (gemm_operand){ a->data, a->cols, 1 },
+             (gemm_operand){ b->data, 1, b->cols },
+             out->data, out->cols, epilogue);
+}
+
+void mat_mul_tn(matrix* out, const matrix* a, const matrix* b, const gemm_epilogue* epilogue){
+    gemm_f32_ex(out->rows, out->cols, a->rows,
+             (gemm_operand){ a->data, 1, a->cols },
+             (gemm_operand){ b->data, b->cols, 1 },
+             out->data, out->cols, epilogue);
+}
+
+void mat_mul_tt(matrix* out, const matrix* a, const matrix* b, const gemm_epilogue* epilogue){
+    gemm_f32_ex(out->rows, out->cols, a->rows,
+             (gemm_operand){ a->data, 1, a->cols },
+             (gemm_operand){ b->data, 1, b->cols },
+             out->data, out->cols, epilogue);
 }
 
 b32 mul_matrix(matrix* out, const matrix* a, const matrix* b, b8 zero_output, b8 transpose_a, b8 transpose_b){
+  return mul_matrix_epilogue(out, a, b, zero_output, transpose_a, transpose_b, NULL);
+}
+
+b32 mul_matrix_epilogue(matrix* out, const matrix* a, const matrix* b, b8 zero_output, b8 transpose_a, b8 transpose_b, const mat_epilogue* epilogue){
 
   u32 a_rows = transpose_a ? a->cols : a->rows;
   u32 a_cols = transpose_a ? a->rows : a->cols;
@@ -268,15 +1062,38 @@ b32 mul_matrix(matrix* out, const matrix* a, const matrix* b, b8 zero_output, b8
   if(out->rows != a_rows || out->cols != b_cols)
     return false;
 
+  gemm_epilogue gemm_ep = { 0 };
+
+  if(epilogue){
+    if(epilogue->bias){
+      if((u64)epilogue->bias->rows * epilogue->bias->cols != out->cols)
+        return false;
+
+      gemm_ep.bias = epilogue->bias->data;
+    }
+
+    if(epilogue->relu_mask){
+      if(epilogue->relu_mask->rows != out->rows || epilogue->relu_mask->cols != out->cols)
+        return false;
+
+      gemm_ep.relu_mask = epilogue->relu_mask->data;
+      gemm_ep.ld_relu_mask = epilogue->relu_mask->cols;
+    }
+
+    gemm_ep.relu = epilogue->relu;
+  }
+
   if(zero_output)
     clear_matrix(out);
 
+  const gemm_epilogue* ep = epilogue ? &gemm_ep : NULL;
+
   u32 transpose = (transpose_a << 1) | transpose_b;
   switch (transpose){
-    case 0b00: {mat_mul_nn(out, a, b);} break;
-    case 0b01: {mat_mul_nt(out, a, b);} break;
-    case 0b10: {mat_mul_tn(out, a, b);} break;
-    case 0b11: {mat_mul_tt(out, a, b);} break;
+    case 0b00: {mat_mul_nn(out, a, b, ep);} break;
+    case 0b01: {mat_mul_nt(out, a, b, ep);} break;
+    case 0b10: {mat_mul_tn(out, a, b, ep);} break;
+    case 0b11: {mat_mul_tt(out, a, b, ep);} break;
   }
 
   return true;
@@ -295,44 +1112,1282 @@ b32 relu_matrix(matrix* out, const matrix* in){
   return true;
 }
 
+// one distribution per row, i.e. per sample of a batch
 b32 softmax_matrix(matrix* out, const matrix* in){
   if (out->rows != in->rows || out->cols != in->cols) {
     return false;
   }
 
-  u64 size = (u64)out->rows * out->cols;
+  for (u64 i = 0; i < out->rows; i++) {
+    vm_softmax_row(&out->data[i * out->cols], &in->data[i * in->cols], in->cols);
+  }
 
-  f32 max = in->data[0];
-  for (u64 i = 1; i < size; i++)
-      if (in->data[i] > max) max = in->data[i];
+  return true;
+}
 
-  f32 sum = 0.0f;
+b32 cross_entropy_matrix(matrix* out, const matrix* expected_probab, const matrix* actual_probab){
+  if (expected_probab->rows != actual_probab->rows || expected_probab->cols != actual_probab->cols) {
+    return false;
+  }
+  if (out->rows != expected_probab->rows || out->cols != expected_probab->cols) {
+    return false;
+  }
+
+  u64 size = (u64)out->rows * out->cols;
   for (u64 i = 0; i < size; i++) {
-      out->data[i] = expf(in->data[i] - max);
-      sum += out->data[i];
+    out->data[i] = expected_probab->data[i] == 0.0f ? 0.0f : expected_probab->data[i] * -logf(actual_probab->data[i]);
   }
 
-  scale_matrix(out, 1.0f / sum);
+  return true;
+}
+
+// class index held in a float, checked before the cast since a negative one converts to garbage
+static b32 _label_index(f32 label, u32 cols, u32* index){
+  if (!(label >= 0.0f && label < (f32)cols)) {
+    return false;
+  }
 
+  *index = (u32)label;
   return true;
 }
 
-b32 cross_entropy_matrix(matrix* out, const matrix* expected_probab, const matrix* actual_probab){
+b32 softmax_cross_entropy_matrix(matrix* loss, matrix* grad, const matrix* logits, const matrix* labels){
+  b32 one_hot = labels->rows == logits->rows && labels->cols == logits->cols;
+  b32 indices = labels->rows == logits->rows && labels->cols == 1;
+
+  if (!one_hot && !indices) {
+    return false;
+  }
+  if (loss->rows != logits->rows || loss->cols != 1) {
+    return false;
+  }
+  if (grad && (grad->rows != logits->rows || grad->cols != logits->cols)) {
+    return false;
+  }
+
+  u32 cols = logits->cols;
+  f32 grad_scale = 1.0f / logits->rows;
+
+  for (u64 i = 0; i < logits->rows; i++) {
+    const f32* target = one_hot ? &labels->data[i * cols] : NULL;
+    u32 target_index = 0;
+
+    if (!one_hot && !_label_index(labels->data[i], cols, &target_index)) {
+      return false;
+    }
+
+    loss->data[i] = vm_softmax_xent_row(
+      grad ? &grad->data[i * cols] : NULL, &logits->data[i * cols],
+      target, target_index, cols, grad_scale
+    );
+  }
+
+  return true;
+}
+
+b32 grad_softmax_cross_entropy_add_matrix(matrix* out, const matrix* logits, const matrix* labels, const matrix* grad){
+  b32 one_hot = labels->rows == logits->rows && labels->cols == logits->cols;
+  b32 indices = labels->rows == logits->rows && labels->cols == 1;
+
+  if (!one_hot && !indices) {
+    return false;
+  }
+  if (grad->rows != logits->rows || grad->cols != 1) {
+    return false;
+  }
+  if (out->rows != logits->rows || out->cols != logits->cols) {
+    return false;
+  }
+
+  u32 cols = logits->cols;
+  u32 target_index = 0;
+
+  // all rows up front, so a bad label leaves out as it was
+  for (u64 i = 0; indices && i < logits->rows; i++) {
+    if (!_label_index(labels->data[i], cols, &target_index)) {
+      return false;
+    }
+  }
+
+  for (u64 i = 0; i < logits->rows; i++) {
+    const f32* target = one_hot ? &labels->data[i * cols] : NULL;
+    if (!one_hot) { _label_index(labels->data[i], cols, &target_index); }
+
+    vm_softmax_xent_grad_add_row(&out->data[i * cols], &logits->data[i * cols], target, target_index, cols, grad->data[i]);
+  }
+
+  return true;
+}
+
+b32 grad_relu_add_matrix(matrix* out, const matrix* in, const matrix* grad){
+  if (in->rows != grad->rows || in->cols != grad->cols) {
+    return false;
+  }
+  if (out->rows != in->rows || out->cols != in->cols) {
+    return false;
+  }
+
+  vm_relu_grad_add(out->data, in->data, grad->data, (u64)out->rows * out->cols);
+
+  return true;
+}
+
+b32 grad_softmax_add_matrix(matrix* out, const matrix* softmax_out, const matrix* grad){
+  if (softmax_out->rows != grad->rows || softmax_out->cols != grad->cols) {
+    return false;
+  }
+  if (out->rows != softmax_out->rows || out->cols != softmax_out->cols) {
+    return false;
+  }
+
+  // softmax_matrix works per row, so its Jacobian is block diagonal
+  for (u64 i = 0; i < out->rows; i++) {
+    u64 offset = i * out->cols;
+    vm_softmax_grad_add_row(&out->data[offset], &softmax_out->data[offset], &grad->data[offset], out->cols);
+  }
+
+  return true;
+}
+
+b32 grad_cross_entropy_add_matrix(matrix* out, const matrix* expected_probab, const matrix* actual_probab, const matrix* grad){
   if (expected_probab->rows != actual_probab->rows || expected_probab->cols != actual_probab->cols) {
     return false;
   }
-  if (out->rows != expected_probab->rows || out->cols != expected_probab->cols) {
+  if (grad->rows != actual_probab->rows || grad->cols != actual_probab->cols) {
+    return false;
+  }
+  if (out->rows != actual_probab->rows || out->cols != actual_probab->cols) {
     return false;
   }
 
-  u64 size = (u64)out->rows * out->cols;
+  vm_xent_grad_add(out->data, expected_probab->data, actual_probab->data, grad->data, (u64)out->rows * out->cols);
+
+  return true;
+}
+
+#define GRAD_CHECK_EPSILON 1e-3f
+#define GRAD_CHECK_TOLERANCE 1e-2f
+
+typedef b32 (grad_check_forward)(matrix* out, const matrix* x, const matrix* aux);
+
+static b32 grad_check_relu(matrix* out, const matrix* x, const matrix* aux){
+  (void)aux;
+  return relu_matrix(out, x);
+}
+
+static b32 grad_check_softmax(matrix* out, const matrix* x, const matrix* aux){
+  (void)aux;
+  return softmax_matrix(out, x);
+}
+
+static b32 grad_check_cross_entropy(matrix* out, const matrix* x, const matrix* aux){
+  return cross_entropy_matrix(out, aux, x);
+}
+
+static b32 grad_check_softmax_cross_entropy(matrix* out, const matrix* x, const matrix* aux){
+  return softmax_cross_entropy_matrix(out, NULL, x, aux);
+}
+
+// relu(x*aux), the relu done by the gemm's epilogue
+static b32 grad_check_dense_relu(matrix* out, const matrix* x, const matrix* aux){
+  mat_epilogue epilogue = { .relu = true };
+  return mul_matrix_epilogue(out, x, aux, true, false, false, &epilogue);
+}
+
+// relu(x)*aux, whose backward is the relu masked gemm of a dense relu layer's input
+static b32 grad_check_relu_dense(matrix* out, const matrix* x, const matrix* aux){
+  mem_arena_temp scratch = arena_scratch_get(NULL, 0);
+
+  matrix* act = create_matrix(scratch.arena, x->rows, x->cols);
+  b32 ok = act != NULL && relu_matrix(act, x) && mul_matrix(out, act, aux, true, false, false);
+
+  arena_scratch_release(scratch);
+
+  return ok;
+}
+
+// the objective is sum(weight * forward(x)), so weight is the upstream gradient
+static f64 grad_check_objective(grad_check_forward* forward, matrix* y, const matrix* x, const matrix* aux, const matrix* weight){
+  forward(y, x, aux);
+
+  f64 sum = 0.0;
+  u64 size = (u64)y->rows * y->cols;
+  for (u64 i = 0; i < size; i++) {
+    sum += (f64)weight->data[i] * y->data[i];
+  }
+
+  return sum;
+}
+
+// largest relative difference between analytic and central difference gradients
+static f32 grad_check_max_error(mem_arena* arena, grad_check_forward* forward, matrix* x, const matrix* aux, const matrix* weight, const matrix* analytic){
+  mem_arena_temp temp = arena_temp_begin(arena);
+
+  matrix* y = create_matrix(arena, weight->rows, weight->cols);
+
+  f32 max_error = 0.0f;
+  u64 size = (u64)x->rows * x->cols;
+
+  for (u64 i = 0; i < size; i++) {
+    f32 orig = x->data[i];
+
+    x->data[i] = orig + GRAD_CHECK_EPSILON;
+    f64 plus = grad_check_objective(forward, y, x, aux, weight);
+    x->data[i] = orig - GRAD_CHECK_EPSILON;
+    f64 minus = grad_check_objective(forward, y, x, aux, weight);
+    x->data[i] = orig;
+
+    f32 numeric = (f32)((plus - minus) / (2.0 * GRAD_CHECK_EPSILON));
+    f32 error = fabsf(numeric - analytic->data[i]) / MAX(1.0f, fabsf(numeric) + fabsf(analytic->data[i]));
+
+    max_error = MAX(max_error, error);
+  }
+
+  arena_temp_end(temp);
+
+  return max_error;
+}
+
+static void grad_check_fill(matrix* mat, f32 lo, f32 hi){
+  u64 size = (u64)mat->rows * mat->cols;
   for (u64 i = 0; i < size; i++) {
-    out->data[i] = expected_probab->data[i] == 0.0f ? 0.0f : expected_probab->data[i] * -logf(expected_probab->data[i]);
+    mat->data[i] = lo + (hi - lo) * prng_randf();
+  }
+}
+
+b32 check_gradients(mem_arena* arena){
+  mem_arena_temp temp = arena_temp_begin(arena);
+
+  const u32 rows = 4, cols = 10;
+
+  matrix* x = create_matrix(arena, rows, cols);
+  matrix* aux = create_matrix(arena, rows, cols);
+  matrix* weight = create_matrix(arena, rows, cols);
+  matrix* base = create_matrix(arena, rows, cols);
+  matrix* out = create_matrix(arena, rows, cols);
+
+  grad_check_fill(weight, -1.0f, 1.0f);
+  // out starts non-zero, so the add semantics get checked too
+  grad_check_fill(base, -1.0f, 1.0f);
+
+  b32 passed = true;
+  f32 error = 0.0f;
+
+  // relu, keeping inputs away from the kink at 0
+  grad_check_fill(x, 0.1f, 1.0f);
+  for (u64 i = 0; i < (u64)rows * cols; i += 2) {
+    x->data[i] = -x->data[i];
+  }
+  copy_matrix(out, base);
+  grad_relu_add_matrix(out, x, weight);
+  sub_matrix(out, out, base);
+  error = grad_check_max_error(arena, grad_check_relu, x, NULL, weight, out);
+  passed &= error < GRAD_CHECK_TOLERANCE;
+  printf("grad_relu_add_matrix: max error %g\n", error);
+
+  // softmax
+  grad_check_fill(x, -2.0f, 2.0f);
+  copy_matrix(out, base);
+  softmax_matrix(aux, x);
+  grad_softmax_add_matrix(out, aux, weight);
+  sub_matrix(out, out, base);
+  error = grad_check_max_error(arena, grad_check_softmax, x, NULL, weight, out);
+  passed &= error < GRAD_CHECK_TOLERANCE;
+  printf("grad_softmax_add_matrix: max error %g\n", error);
+
+  // cross entropy, with some zero entries in the expected distribution
+  grad_check_fill(x, 0.1f, 1.0f);
+  grad_check_fill(aux, 0.0f, 1.0f);
+  for (u64 i = 0; i < (u64)rows * cols; i += 3) {
+    aux->data[i] = 0.0f;
+  }
+  copy_matrix(out, base);
+  grad_cross_entropy_add_matrix(out, aux, x, weight);
+  sub_matrix(out, out, base);
+  error = grad_check_max_error(arena, grad_check_cross_entropy, x, aux, weight, out);
+  passed &= error < GRAD_CHECK_TOLERANCE;
+  printf("grad_cross_entropy_add_matrix: max error %g\n", error);
+
+  // softmax cross entropy, per-sample loss against class indices and then one-hot rows
+  matrix* loss_weight = create_matrix(arena, rows, 1);
+  matrix* classes = create_matrix(arena, rows, 1);
+  grad_check_fill(loss_weight, -1.0f, 1.0f);
+  grad_check_fill(x, -2.0f, 2.0f);
+  for (u32 i = 0; i < rows; i++) {
+    classes->data[i] = (f32)((i * 7) % cols);
+  }
+  copy_matrix(out, base);
+  grad_softmax_cross_entropy_add_matrix(out, x, classes, loss_weight);
+  sub_matrix(out, out, base);
+  error = grad_check_max_error(arena, grad_check_softmax_cross_entropy, x, classes, loss_weight, out);
+
+  // the gradient assumes each target row sums to 1
+  grad_check_fill(aux, 0.0f, 1.0f);
+  for (u32 i = 0; i < rows; i++) {
+    f32 mass = 0.0f;
+    for (u32 j = 0; j < cols; j++) { mass += aux->data[i * cols + j]; }
+    for (u32 j = 0; j < cols; j++) { aux->data[i * cols + j] /= mass; }
+  }
+  copy_matrix(out, base);
+  grad_softmax_cross_entropy_add_matrix(out, x, aux, loss_weight);
+  sub_matrix(out, out, base);
+  error = MAX(error, grad_check_max_error(arena, grad_check_softmax_cross_entropy, x, aux, loss_weight, out));
+  passed &= error < GRAD_CHECK_TOLERANCE;
+  printf("grad_softmax_cross_entropy_add_matrix: max error %g\n", error);
+
+  // dense relu, square weights so the shapes line up, inputs again away from the kink
+  matrix* dense_w = create_matrix(arena, cols, cols);
+  matrix* masked = create_matrix(arena, rows, cols);
+  grad_check_fill(dense_w, -1.0f, 1.0f);
+  for (u32 tries = 0; tries < 100; tries++) {
+    grad_check_fill(x, -1.0f, 1.0f);
+    mul_matrix(aux, x, dense_w, true, false, false);
+
+    f32 min_abs = INFINITY;
+    for (u64 i = 0; i < (u64)rows * cols; i++) {
+      min_abs = MIN(min_abs, fabsf(aux->data[i]));
+    }
+    if (min_abs > 0.05f) {
+      break;
+    }
+  }
+  grad_check_dense_relu(aux, x, dense_w);
+  clear_matrix(masked);
+  grad_relu_add_matrix(masked, aux, weight);
+  copy_matrix(out, base);
+  mul_matrix(out, masked, dense_w, false, false, true);
+  sub_matrix(out, out, base);
+  error = grad_check_max_error(arena, grad_check_dense_relu, x, dense_w, weight, out);
+  passed &= error < GRAD_CHECK_TOLERANCE;
+  printf("mul_matrix_epilogue relu: max error %g\n", error);
+
+  // relu masked gemm, which masks the old contents of out as well
+  grad_check_fill(x, 0.1f, 1.0f);
+  for (u64 i = 0; i < (u64)rows * cols; i += 2) {
+    x->data[i] = -x->data[i];
   }
+  mat_epilogue epilogue = { .relu_mask = x };
+  clear_matrix(masked);
+  grad_relu_add_matrix(masked, x, base);
+  copy_matrix(out, base);
+  mul_matrix_epilogue(out, weight, dense_w, false, false, true, &epilogue);
+  sub_matrix(out, out, masked);
+  error = grad_check_max_error(arena, grad_check_relu_dense, x, dense_w, weight, out);
+  passed &= error < GRAD_CHECK_TOLERANCE;
+  printf("mul_matrix_epilogue relu_mask: max error %g\n", error);
+
+  printf("gradient check %s\n", passed ? "passed" : "FAILED");
+
+  arena_temp_end(temp);
+
+  return passed;
+}
+
+// the header from the model's pool, the data (if any) from the arena
+static matrix* _mv_matrix(mem_arena* arena, model_context* model, u32 rows, u32 cols, b32 with_data){
+  matrix* mat = POOL_ALLOC_STRUCT(&model->matrix_pool, matrix);
+  if (!mat) {
+    return NULL;
+  }
+
+  mat->rows = rows;
+  mat->cols = cols;
+
+  if (with_data) {
+    mat->data = PUSH_ARRAY_ALIGNED(arena, f32, (u64)rows * cols, ARENA_SIMD_ALIGN);
+
+    if (!mat->data) {
+      pool_free(&model->matrix_pool, mat);
+      return NULL;
+    }
+  }
+
+  return mat;
+}
+
+static model_var* _mv_push(mem_arena* arena, model_context* model, u32 rows, u32 cols, u32 flags, model_var_op op, model_var* a, model_var* b, model_var* c){
+  if (model->var_pool.arena == NULL) {
+    POOL_INIT_STRUCT(&model->var_pool, arena, model_var);
+    POOL_INIT_STRUCT(&model->matrix_pool, arena, matrix);
+  }
+
+  model_var* var = POOL_ALLOC_STRUCT(&model->var_pool, model_var);
+  if (!var) {
+    return NULL;
+  }
+
+  var->op = op;
+  var->inputs[0] = a;
+  var->inputs[1] = b;
+  var->inputs[2] = c;
+
+  for (u32 i = 0; i < MV_NUM_INPUTS(op); i++) {
+    if (var->inputs[i]->flags & MV_FLAG_REQUIRES_GRAD) {
+      flags |= MV_FLAG_REQUIRES_GRAD;
+    }
+  }
+
+  var->flags = flags;
+
+  // leaves get their data now, the program gives everything else theirs
+  b32 with_data = op == MV_OP_NULL;
+
+  var->val = _mv_matrix(arena, model, rows, cols, with_data);
+
+  if (var->val && (flags & MV_FLAG_REQUIRES_GRAD)) {
+    var->grad = _mv_matrix(arena, model, rows, cols, with_data);
+  }
+
+  if (!var->val || ((flags & MV_FLAG_REQUIRES_GRAD) && !var->grad)) {
+    pool_free(&model->matrix_pool, var->val);
+    pool_free(&model->var_pool, var);
+    return NULL;
+  }
+
+  var->index = model->num_vars++;
+
+  return var;
+}
+
+model_var* mv_create(mem_arena* arena, model_context* model, u32 rows, u32 cols, u32 flags){
+  return _mv_push(arena, model, rows, cols, flags, MV_OP_NULL, NULL, NULL, NULL);
+}
+
+model_var* mv_relu(mem_arena* arena, model_context* model, model_var* in, u32 flags){
+  if (!in) {
+    return NULL;
+  }
+
+  return _mv_push(arena, model, in->val->rows, in->val->cols, flags, MV_OP_RELU, in, NULL, NULL);
+}
+
+model_var* mv_softmax(mem_arena* arena, model_context* model, model_var* in, u32 flags){
+  if (!in) {
+    return NULL;
+  }
+
+  return _mv_push(arena, model, in->val->rows, in->val->cols, flags, MV_OP_SOFTMAX, in, NULL, NULL);
+}
+
+model_var* mv_add(mem_arena* arena, model_context* model, model_var* a, model_var* b, u32 flags){
+  if (!a || !b || a->val->rows != b->val->rows || a->val->cols != b->val->cols) {
+    return NULL;
+  }
+
+  return _mv_push(arena, model, a->val->rows, a->val->cols, flags, MV_OP_ADD, a, b, NULL);
+}
+
+model_var* mv_sub(mem_arena* arena, model_context* model, model_var* a, model_var* b, u32 flags){
+  if (!a || !b || a->val->rows != b->val->rows || a->val->cols != b->val->cols) {
+    return NULL;
+  }
+
+  return _mv_push(arena, model, a->val->rows, a->val->cols, flags, MV_OP_SUB, a, b, NULL);
+}
+
+model_var* mv_matmul(mem_arena* arena, model_context* model, model_var* a, model_var* b, u32 flags){
+  if (!a || !b || a->val->cols != b->val->rows) {
+    return NULL;
+  }
+
+  return _mv_push(arena, model, a->val->rows, b->val->cols, flags, MV_OP_MATMUL, a, b, NULL);
+}
+
+model_var* mv_add_bias(mem_arena* arena, model_context* model, model_var* a, model_var* bias, u32 flags){
+  if (!a || !bias || bias->val->rows != 1 || bias->val->cols != a->val->cols) {
+    return NULL;
+  }
+
+  return _mv_push(arena, model, a->val->rows, a->val->cols, flags, MV_OP_ADD_BIAS, a, bias, NULL);
+}
+
+model_var* mv_cross_entropy(mem_arena* arena, model_context* model, model_var* expected_probab, model_var* actual_probab, u32 flags){
+  if (!expected_probab || !actual_probab || expected_probab->val->rows != actual_probab->val->rows || expected_probab->val->cols != actual_probab->val->cols) {
+    return NULL;
+  }
+
+  return _mv_push(arena, model, actual_probab->val->rows, actual_probab->val->cols, flags, MV_OP_CROSS_ENTROPY, expected_probab, actual_probab, NULL);
+}
+
+model_var* mv_softmax_cross_entropy(mem_arena* arena, model_context* model, model_var* logits, model_var* labels, u32 flags){
+  if (!logits || !labels || labels->val->rows != logits->val->rows || (labels->val->cols != logits->val->cols && labels->val->cols != 1)) {
+    return NULL;
+  }
+
+  return _mv_push(arena, model, logits->val->rows, 1, flags, MV_OP_SOFTMAX_CROSS_ENTROPY, logits, labels, NULL);
+}
+
+model_var* mv_dense(mem_arena* arena, model_context* model, model_var* a, model_var* w, model_var* bias, b32 relu, u32 flags){
+  if (!a || !w || !bias || a->val->cols != w->val->rows || bias->val->rows != 1 || bias->val->cols != w->val->cols) {
+    return NULL;
+  }
+
+  model_var_op op = relu ? MV_OP_DENSE_RELU : MV_OP_DENSE;
+
+  return _mv_push(arena, model, a->val->rows, w->val->cols, flags, op, a, w, bias);
+}
+
+#define MODEL_BUFFER_ALIGN 64
+
+// one value or grad matrix of an intermediate var
+typedef struct{
+  matrix* mat;
+  u64 size;
+  // first and last step it's used at, forward steps are [0, n), backward steps [n, 2n)
+  u32 start, end;
+  // buffer it runs in place on, or -1
+  i32 group;
+  u64 offset;
+} _mv_buffer;
+
+static u32 _mv_backward_step(u32 n, u32 pos){
+  return 2 * n - 1 - pos;
+}
+
+// which inputs the backward of op reads the values of
+static void _mv_backward_reads(const model_var* var, b32 reads[MODEL_VAR_MAX_INPUTS]){
+  b32 a_grad = MV_NUM_INPUTS(var->op) > 0 && (var->inputs[0]->flags & MV_FLAG_REQUIRES_GRAD);
+  b32 b_grad = MV_NUM_INPUTS(var->op) > 1 && (var->inputs[1]->flags & MV_FLAG_REQUIRES_GRAD);
+
+  for (u32 i = 0; i < MODEL_VAR_MAX_INPUTS; i++) {
+    reads[i] = false;
+  }
+
+  switch (var->op) {
+    case MV_OP_MATMUL: {
+      reads[0] = b_grad;
+      reads[1] = a_grad;
+    } break;
+    case MV_OP_DENSE:
+    case MV_OP_DENSE_RELU: {
+      // a dense relu input's value is the mask of the gemm producing its grad
+      reads[0] = b_grad || (a_grad && var->inputs[0]->op == MV_OP_DENSE_RELU);
+      reads[1] = a_grad;
+    } break;
+    case MV_OP_CROSS_ENTROPY: {
+      reads[0] = b_grad;
+      reads[1] = a_grad || b_grad;
+    } break;
+    case MV_OP_SOFTMAX_CROSS_ENTROPY: {
+      reads[0] = a_grad;
+      reads[1] = a_grad;
+    } break;
+    // relu, softmax and dense relu only need their own output, the rest no values at all
+    default: break;
+  }
+}
+
+static b32 _mv_is_elementwise(model_var_op op){
+  // softmax works per row but vm_softmax_row allows out == in
+  return op == MV_OP_RELU || op == MV_OP_SOFTMAX || op == MV_OP_ADD || op == MV_OP_SUB || op == MV_OP_ADD_BIAS;
+}
+
+static i32 _mv_group_root(_mv_buffer* buffers, i32 i){
+  while (buffers[i].group != -1) {
+    i = buffers[i].group;
+  }
+  return i;
+}
+
+// false if the arena runs out, every buffer this gave memory to is reset
+static b32 _mv_prog_alloc(mem_arena* arena, model_context* model, model_program* prog, b32 plan_memory){
+  mem_arena_temp scratch = arena_scratch_get(&arena, 1);
+
+  u32 n = prog->size;
+
+  // value buffer of var i at 2*pos, its grad buffer at 2*pos + 1
+  _mv_buffer* buffers = PUSH_ARRAY(scratch.arena, _mv_buffer, 2 * (u64)n);
+  i32* pos = PUSH_ARRAY_NZ(scratch.arena, i32, model->num_vars);
+
+  for (u32 i = 0; i < model->num_vars; i++) {
+    pos[i] = -1;
+  }
+
+  for (u32 i = 0; i < n; i++) {
+    model_var* var = prog->vars[i];
+    pos[var->index] = i;
+
+    _mv_buffer* val = &buffers[2 * i];
+    _mv_buffer* grad = &buffers[2 * i + 1];
+
+    val->group = grad->group = -1;
+
+    // leaves and vars another program already gave memory to keep theirs
+    if (var->op == MV_OP_NULL || var->val->data != NULL) { continue; }
+
+    u64 size = ALIGN_UP_POW2(sizeof(f32) * var->val->rows * var->val->cols, MODEL_BUFFER_ALIGN);
+
+    b32 keep = (var->flags & MV_FLAG_OUTPUT) || i == n - 1;
+
+    *val = (_mv_buffer){ .mat = var->val, .size = size, .start = i, .end = keep ? 2 * n : i, .group = -1 };
+
+    if (var->flags & MV_FLAG_REQUIRES_GRAD) {
+      u32 step = _mv_backward_step(n, i);
+      // the output's grad is seeded when the backward sweep starts
+      *grad = (_mv_buffer){ .mat = var->grad, .size = size, .start = i == n - 1 ? n : step, .end = step, .group = -1 };
+    }
+  }
+
+  // extend the lifetimes by every forward and backward use
+  for (u32 i = 0; i < n; i++) {
+    model_var* var = prog->vars[i];
+    u32 num_inputs = MV_NUM_INPUTS(var->op);
+
+    b32 reads[MODEL_VAR_MAX_INPUTS];
+    _mv_backward_reads(var, reads);
+
+    b32 has_backward = (var->flags & MV_FLAG_REQUIRES_GRAD) != 0;
+    u32 step = _mv_backward_step(n, i);
+
+    if (has_backward && (var->op == MV_OP_RELU || var->op == MV_OP_SOFTMAX || var->op == MV_OP_DENSE_RELU)) {
+      buffers[2 * i].end = MAX(buffers[2 * i].end, step);
+    }
+
+    for (u32 j = 0; j < num_inputs; j++) {
+      model_var* in = var->inputs[j];
+      u32 in_pos = pos[in->index];
+
+      _mv_buffer* val = &buffers[2 * in_pos];
+      _mv_buffer* grad = &buffers[2 * in_pos + 1];
+
+      val->end = MAX(val->end, i);
+
+      if (has_backward && reads[j]) {
+        val->end = MAX(val->end, step);
+      }
+
+      if (has_backward && (in->flags & MV_FLAG_REQUIRES_GRAD)) {
+        grad->start = MIN(grad->start, step);
+      }
+    }
+  }
+
+  u64 unplanned = 0;
+  for (u32 i = 0; i < 2 * n; i++) {
+    unplanned += buffers[i].size;
+  }
+
+  if (!plan_memory) {
+    mem_arena_temp temp = arena_temp_begin(arena);
+
+    for (u32 i = 0; i < 2 * n; i++) {
+      if (buffers[i].size == 0) { continue; }
+
+      buffers[i].mat->data = (f32*)ARENA_PUSH(arena, buffers[i].size, MODEL_BUFFER_ALIGN, true);
+
+      if (!buffers[i].mat->data) {
+        for (u32 j = 0; j < i; j++) {
+          if (buffers[j].size != 0) { buffers[j].mat->data = NULL; }
+        }
+
+        arena_temp_end(temp);
+        arena_scratch_release(scratch);
+        return false;
+      }
+    }
+
+    prog->activation_bytes = unplanned;
+    prog->unplanned_activation_bytes = unplanned;
+
+    arena_scratch_release(scratch);
+    return true;
+  }
+
+  // in place: an elementwise op takes over the buffer of an input
+  // whose value isn't read after this op
+  for (u32 i = 0; i < n; i++) {
+    model_var* var = prog->vars[i];
+    _mv_buffer* val = &buffers[2 * i];
+
+    if (val->size == 0 || !_mv_is_elementwise(var->op)) { continue; }
+
+    for (u32 j = 0; j < MV_NUM_INPUTS(var->op); j++) {
+      model_var* in = var->inputs[j];
+      u32 in_pos = pos[in->index];
+      i32 root = _mv_group_root(buffers, 2 * in_pos);
+      _mv_buffer* in_val = &buffers[root];
+
+      if (in_val->size != val->size || in_val->end != i) { continue; }
+      if (in->val->rows != var->val->rows || in->val->cols != var->val->cols) { continue; }
+
+      in_val->end = val->end;
+      val->group = root;
+      break;
+    }
+  }
+
+  // greedy by size: biggest buffers first, each at the lowest offset
+  // that doesn't collide with a placed buffer alive at the same time
+  i32* order = PUSH_ARRAY_NZ(scratch.arena, i32, 2 * (u64)n);
+  u32 num_placed = 0;
+  u32 num_buffers = 0;
+
+  for (u32 i = 0; i < 2 * n; i++) {
+    if (buffers[i].size != 0 && buffers[i].group == -1) {
+      order[num_buffers++] = i;
+    }
+  }
+
+  for (u32 i = 1; i < num_buffers; i++) {
+    i32 cur = order[i];
+    u32 j = i;
+
+    while (j > 0 && buffers[order[j - 1]].size < buffers[cur].size) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = cur;
+  }
+
+  u64 total = 0;
+
+  for (u32 i = 0; i < num_buffers; i++) {
+    _mv_buffer* cur = &buffers[order[i]];
+    u64 offset = 0;
+
+    // bump past every collision until there are none left
+    b32 moved = true;
+    while (moved) {
+      moved = false;
+
+      for (u32 j = 0; j < num_placed; j++) {
+        _mv_buffer* other = &buffers[order[j]];
+
+        b32 time_overlap = cur->start <= other->end && other->start <= cur->end;
+        b32 space_overlap = offset < other->offset + other->size && other->offset < offset + cur->size;
+
+        if (time_overlap && space_overlap) {
+          offset = other->offset + other->size;
+          moved = true;
+        }
+      }
+    }
+
+    cur->offset = offset;
+    total = MAX(total, offset + cur->size);
+    num_placed++;
+  }
+
+  u8* region = (u8*)ARENA_PUSH(arena, total, MODEL_BUFFER_ALIGN, true);
+  if (!region) {
+    arena_scratch_release(scratch);
+    return false;
+  }
+
+  for (u32 i = 0; i < 2 * n; i++) {
+    if (buffers[i].size == 0) { continue; }
+
+    i32 root = _mv_group_root(buffers, i);
+    buffers[i].mat->data = (f32*)(region + buffers[root].offset);
+  }
+
+  prog->activation_bytes = total;
+  prog->unplanned_activation_bytes = unplanned;
+
+  arena_scratch_release(scratch);
 
   return true;
 }
 
-b32 grad_relu_add_matrix(matrix* out, const matrix* in);
-b32 grad_softmax_add_matrix(matrix* out, const matrix* softmax_out);
-b32 grad_cross_entropy_add_matrix(matrix* out, const matrix* expected_probab, const matrix* actual_probab);
+model_program model_prog_create(mem_arena* arena, model_context* model, model_var* out_var, b32 plan_memory){
+  mem_arena_temp temp = arena_temp_begin(arena);
+  mem_arena_temp scratch = arena_scratch_get(&arena, 1);
+
+  b8* visited = PUSH_ARRAY(scratch.arena, b8, model->num_vars);
+
+  // iterative post-order dfs, each stack entry remembers which input it visits next
+  model_var** stack = PUSH_ARRAY_NZ(scratch.arena, model_var*, model->num_vars);
+  u32* next_input = PUSH_ARRAY_NZ(scratch.arena, u32, model->num_vars);
+  u32 stack_size = 0;
+
+  model_var** out = PUSH_ARRAY_NZ(scratch.arena, model_var*, model->num_vars);
+  u32 out_size = 0;
+
+  if (!visited || !stack || !next_input || !out) {
+    arena_scratch_release(scratch);
+    return (model_program){ 0 };
+  }
+
+  stack[stack_size] = out_var;
+  next_input[stack_size++] = 0;
+  visited[out_var->index] = true;
+
+  while (stack_size > 0) {
+    model_var* cur = stack[stack_size - 1];
+    u32* next = &next_input[stack_size - 1];
+
+    if (*next < MV_NUM_INPUTS(cur->op)) {
+      model_var* in = cur->inputs[(*next)++];
+
+      if (!visited[in->index]) {
+        visited[in->index] = true;
+        stack[stack_size] = in;
+        next_input[stack_size++] = 0;
+      }
+      continue;
+    }
+
+    out[out_size++] = cur;
+    stack_size--;
+  }
+
+  model_program prog = {
+    .vars = PUSH_ARRAY_NZ(arena, model_var*, out_size),
+    .size = out_size
+  };
+
+  if (!prog.vars) {
+    arena_scratch_release(scratch);
+    return (model_program){ 0 };
+  }
+
+  memcpy(prog.vars, out, sizeof(model_var*) * out_size);
+
+  arena_scratch_release(scratch);
+
+  if (!_mv_prog_alloc(arena, model, &prog, plan_memory)) {
+    arena_temp_end(temp);
+    return (model_program){ 0 };
+  }
+
+  return prog;
+}
+
+void model_prog_compute(model_program* prog){
+  for (u32 i = 0; i < prog->size; i++) {
+    model_var* cur = prog->vars[i];
+    model_var* a = cur->inputs[0];
+    model_var* b = cur->inputs[1];
+
+    switch (cur->op) {
+      case MV_OP_NULL: break;
+
+      case MV_OP_RELU: { relu_matrix(cur->val, a->val); } break;
+      case MV_OP_SOFTMAX: { softmax_matrix(cur->val, a->val); } break;
+
+      case MV_OP_ADD: { add_matrix(cur->val, a->val, b->val); } break;
+      case MV_OP_SUB: { sub_matrix(cur->val, a->val, b->val); } break;
+      case MV_OP_MATMUL: { mul_matrix(cur->val, a->val, b->val, true, false, false); } break;
+      case MV_OP_ADD_BIAS: { add_bias_matrix(cur->val, a->val, b->val); } break;
+      case MV_OP_CROSS_ENTROPY: { cross_entropy_matrix(cur->val, a->val, b->val); } break;
+      case MV_OP_SOFTMAX_CROSS_ENTROPY: { softmax_cross_entropy_matrix(cur->val, NULL, a->val, b->val); } break;
+
+      case MV_OP_DENSE:
+      case MV_OP_DENSE_RELU: {
+        mat_epilogue epilogue = { .bias = cur->inputs[2]->val, .relu = cur->op == MV_OP_DENSE_RELU };
+        mul_matrix_epilogue(cur->val, a->val, b->val, true, false, false, &epilogue);
+      } break;
+    }
+  }
+}
+
+// grad = 0 wherever val isn't positive, what relu's backward does to a dense relu var's grad
+static void _mv_relu_mask(matrix* grad, const matrix* val){
+  u64 size = (u64)grad->rows * grad->cols;
+  for (u64 i = 0; i < size; i++) {
+    grad->data[i] = val->data[i] > 0.0f ? grad->data[i] : 0.0f;
+  }
+}
+
+// out += column sums of grad, for the bias of every row
+static void _mv_bias_grad_add(matrix* out, const matrix* grad){
+  for (u64 i = 0; i < grad->rows; i++) {
+    for (u64 j = 0; j < grad->cols; j++) {
+      out->data[j] += grad->data[i * grad->cols + j];
+    }
+  }
+}
+
+void model_prog_compute_grads(model_program* prog){
+  if (prog->size == 0) { return; }
+
+  // grads are cleared right before their first contribution, buffers shared
+  // by the memory planner may still be in use by something else until then
+  for (u32 i = 0; i < prog->size; i++) {
+    prog->vars[i]->grad_live = false;
+    prog->vars[i]->grad_masked = false;
+  }
+
+  model_var* out_var = prog->vars[prog->size - 1];
+  if (!(out_var->flags & MV_FLAG_REQUIRES_GRAD)) { return; }
+
+  fill_matrix(out_var->grad, 1.0f / ((f32)out_var->val->rows * out_var->val->cols));
+  out_var->grad_live = true;
+
+  for (i64 i = (i64)prog->size - 1; i >= 0; i--) {
+    model_var* cur = prog->vars[i];
+    model_var* a = cur->inputs[0];
+    model_var* b = cur->inputs[1];
+    model_var* c = cur->inputs[2];
+
+    if (!(cur->flags & MV_FLAG_REQUIRES_GRAD) || cur->op == MV_OP_NULL) {
+      continue;
+    }
+
+    b32 a_grad = MV_NUM_INPUTS(cur->op) > 0 && (a->flags & MV_FLAG_REQUIRES_GRAD);
+    b32 b_grad = MV_NUM_INPUTS(cur->op) > 1 && (b->flags & MV_FLAG_REQUIRES_GRAD);
+    b32 c_grad = MV_NUM_INPUTS(cur->op) > 2 && (c->flags & MV_FLAG_REQUIRES_GRAD);
+
+    if (a_grad && !a->grad_live) { clear_matrix(a->grad); a->grad_live = true; }
+    if (b_grad && !b->grad_live) { clear_matrix(b->grad); b->grad_live = true; }
+    if (c_grad && !c->grad_live) { clear_matrix(c->grad); c->grad_live = true; }
+
+    // anything but a masked gemm below adds unmasked values
+    if (a_grad) { a->grad_masked = false; }
+    if (b_grad) { b->grad_masked = false; }
+    if (c_grad) { c->grad_masked = false; }
+
+    matrix* grad = cur->grad;
+
+    switch (cur->op) {
+      case MV_OP_NULL: break;
+
+      case MV_OP_RELU: {
+        // relu(x) > 0 exactly where x > 0, so the input can be overwritten in place
+        if (a_grad) { grad_relu_add_matrix(a->grad, cur->val, grad); }
+      } break;
+      case MV_OP_SOFTMAX: {
+        if (a_grad) { grad_softmax_add_matrix(a->grad, cur->val, grad); }
+      } break;
+
+      case MV_OP_ADD: {
+        if (a_grad) { add_matrix(a->grad, a->grad, grad); }
+        if (b_grad) { add_matrix(b->grad, b->grad, grad); }
+      } break;
+      case MV_OP_SUB: {
+        if (a_grad) { add_matrix(a->grad, a->grad, grad); }
+        if (b_grad) { sub_matrix(b->grad, b->grad, grad); }
+      } break;
+      case MV_OP_MATMUL: {
+        if (a_grad) { mul_matrix(a->grad, grad, b->val, false, false, true); }
+        if (b_grad) { mul_matrix(b->grad, a->val, grad, false, true, false); }
+      } break;
+      case MV_OP_ADD_BIAS: {
+        if (a_grad) { add_matrix(a->grad, a->grad, grad); }
+        if (b_grad) { _mv_bias_grad_add(b->grad, grad); }
+      } break;
+      case MV_OP_CROSS_ENTROPY: {
+        if (a_grad) {
+          // d/dp of -p * log(q) is -log(q)
+          u64 size = (u64)grad->rows * grad->cols;
+          for (u64 j = 0; j < size; j++) {
+            a->grad->data[j] -= logf(b->val->data[j]) * grad->data[j];
+          }
+        }
+        if (b_grad) { grad_cross_entropy_add_matrix(b->grad, a->val, b->val, grad); }
+      } break;
+      case MV_OP_SOFTMAX_CROSS_ENTROPY: {
+        // logits grad += loss grad of the row * (softmax - label), added straight into it
+        if (a_grad) { grad_softmax_cross_entropy_add_matrix(a->grad, a->val, b->val, grad); }
+      } break;
+
+      case MV_OP_DENSE:
+      case MV_OP_DENSE_RELU: {
+        // grad becomes the grad of a*w + bias, the gemm that produced it usually did this already
+        if (cur->op == MV_OP_DENSE_RELU && !cur->grad_masked) {
+          _mv_relu_mask(grad, cur->val);
+          cur->grad_masked = true;
+        }
+
+        if (a_grad) {
+          // masking the whole sum is fine, a's own backward would mask it anyway
+          mat_epilogue epilogue = { .relu_mask = a->val };
+          b32 mask = a->op == MV_OP_DENSE_RELU;
+
+          mul_matrix_epilogue(a->grad, grad, b->val, false, false, true, mask ? &epilogue : NULL);
+          a->grad_masked = mask;
+        }
+        if (b_grad) { mul_matrix(b->grad, a->val, grad, false, true, false); }
+        if (c_grad) { _mv_bias_grad_add(c->grad, grad); }
+      } break;
+    }
+  }
+}
+
+// uniform in +-sqrt(6 / (fan_in + fan_out))
+static void _mnist_init_weights(matrix* mat, prng_lanes* rng){
+  f32 limit = sqrtf(6.0f / (mat->rows + mat->cols));
+
+  prng_fill_f32(rng, mat->data, (u64)mat->rows * mat->cols, -limit, limit);
+}
+
+mnist_model* create_mnist_model(mem_arena* arena, u32 batch_size, u32 hidden_size, u64 seed){
+  mnist_model* model = PUSH_STRUCT(arena, mnist_model);
+  if (!model) {
+    fprintf(stderr, "Out of memory for the model\n");
+    return NULL;
+  }
+
+  model_context* ctx = &model->ctx;
+
+  u32 param_flags = MV_FLAG_PARAMETER | MV_FLAG_REQUIRES_GRAD;
+
+  model->input = mv_create(arena, ctx, batch_size, 784, MV_FLAG_INPUT);
+  model->labels = mv_create(arena, ctx, batch_size, 10, MV_FLAG_INPUT);
+
+  model_var* w0 = mv_create(arena, ctx, 784, hidden_size, param_flags);
+  model_var* b0 = mv_create(arena, ctx, 1, hidden_size, param_flags);
+  model_var* w1 = mv_create(arena, ctx, hidden_size, 10, param_flags);
+  model_var* b1 = mv_create(arena, ctx, 1, 10, param_flags);
+
+  if (!model->input || !model->labels || !w0 || !b0 || !w1 || !b1) {
+    fprintf(stderr, "Out of memory for the model\n");
+    return NULL;
+  }
+
+  model->params[model->num_params++] = w0;
+  model->params[model->num_params++] = b0;
+  model->params[model->num_params++] = w1;
+  model->params[model->num_params++] = b1;
+
+  // fault the weights and their grads in from the gemm workers before anything writes them,
+  // each worker gets the rows it computes first in the backward gemms whose C the grads are;
+  // best effort on numa boxes, tiles a worker steals still land on someone else's node
+  model_var* weights[2] = { w0, w1 };
+  for (u32 i = 0; i < 2; i++) {
+    u64 row_size = sizeof(f32) * weights[i]->val->cols;
+
+    gemm_first_touch(weights[i]->val->data, weights[i]->val->rows, row_size);
+    gemm_first_touch(weights[i]->grad->data, weights[i]->grad->rows, row_size);
+  }
+
+  prng_lanes rng;
+  prng_lanes_seed(&rng, seed, 1);
+
+  _mnist_init_weights(w0->val, &rng);
+  _mnist_init_weights(w1->val, &rng);
+
+  model_var* hidden = mv_dense(arena, ctx, model->input, w0, b0, true, 0);
+
+  model->logits = mv_dense(arena, ctx, hidden, w1, b1, false, MV_FLAG_OUTPUT);
+  model->cost = mv_softmax_cross_entropy(arena, ctx, model->logits, model->labels, MV_FLAG_OUTPUT);
+
+  if (!model->cost) {
+    fprintf(stderr, "Out of memory for the model\n");
+    return NULL;
+  }
+
+  model->train_prog = model_prog_create(arena, ctx, model->cost, true);
+  if (model->train_prog.size == 0) {
+    fprintf(stderr, "Out of memory for the training program\n");
+    return NULL;
+  }
+
+  printf(
+    "activation memory: %.1f KiB planned, %.1f KiB unplanned\n",
+    model->train_prog.activation_bytes / 1024.0,
+    model->train_prog.unplanned_activation_bytes / 1024.0
+  );
+
+  return model;
+}
+
+static u32 _argmax_row(const f32* row, u32 n){
+  u32 best = 0;
+  for (u32 i = 1; i < n; i++) {
+    if (row[i] > row[best]) { best = i; }
+  }
+  return best;
+}
+
+f32 evaluate_accuracy(mnist_model* model, const matrix_u8* images, const matrix* labels){
+  matrix* input = model->input->val;
+  matrix* batch_labels = model->labels->val;
+  matrix* logits = model->logits->val;
+
+  u32 batch_size = input->rows;
+  u32 num_batches = (images->rows + batch_size - 1) / batch_size;
+  u32 correct = 0;
+
+  for (u32 batch = 0; batch < num_batches; batch++) {
+    u64 offset = (u64)batch * batch_size;
+    // the last batch can be short, rows are independent so the stale ones past it are just ignored
+    u32 count = (u32)MIN((u64)batch_size, images->rows - offset);
+
+    vm_u8_to_f32(input->data, &images->data[offset * images->cols], (u64)count * images->cols, MNIST_PIXEL_SCALE);
+    memcpy(batch_labels->data, &labels->data[offset * labels->cols], sizeof(f32) * count * labels->cols);
+
+    model_prog_compute(&model->train_prog);
+
+    for (u32 i = 0; i < count; i++) {
+      u32 predicted = _argmax_row(&logits->data[(u64)i * logits->cols], logits->cols);
+      u32 expected = _argmax_row(&batch_labels->data[(u64)i * batch_labels->cols], batch_labels->cols);
+
+      correct += predicted == expected;
+    }
+  }
+
+  return images->rows == 0 ? 0.0f : (f32)correct / images->rows;
+}
+
+// everything the prefetch thread touches, the training loop only reads the filled batches
+typedef struct{
+  const matrix_u8* images;
+  const matrix* labels;
+
+  u32* order;
+  u32 num_samples;
+  u32 num_batches;
+
+  // num_samples - 1 draws for each shuffle, made in one go
+  u32* swap_rand;
+  prng_lanes rng;
+} _batch_source;
+
+static void _fill_batch(void* ctx, void* slot, u64 item){
+  _batch_source* src = (_batch_source*)ctx;
+  mnist_batch* batch = (mnist_batch*)slot;
+
+  u32 batch_index = item % src->num_batches;
+  u32 batch_size = batch->images->rows;
+
+  // fisher-yates, once at the start of every epoch
+  if (batch_index == 0) {
+    prng_fill_u32(&src->rng, src->swap_rand, src->num_samples - 1);
+
+    for (u32 i = src->num_samples - 1; i > 0; i--) {
+      u32 j = src->swap_rand[i - 1] % (i + 1);
+      u32 tmp = src->order[i];
+      src->order[i] = src->order[j];
+      src->order[j] = tmp;
+    }
+  }
+
+  const u32* indices = &src->order[(u64)batch_index * batch_size];
+  gather_rows_u8_matrix(batch->images, src->images, indices, MNIST_PIXEL_SCALE);
+  gather_rows_matrix(batch->labels, src->labels, indices);
+}
+
+b32 train(mem_arena* arena, mnist_model* model, const matrix_u8* train_images, const matrix* train_labels, const matrix_u8* test_images, const matrix* test_labels, const training_desc* desc){
+  u32 num_samples = train_images->rows;
+  u32 batch_size = model->input->val->rows;
+  u32 num_batches = num_samples / batch_size;
+
+  if (num_batches == 0) {
+    return true;
+  }
+
+  _batch_source source = {
+    .images = train_images,
+    .labels = train_labels,
+    .order = PUSH_ARRAY_NZ(arena, u32, num_samples),
+    .num_samples = num_samples,
+    .num_batches = num_batches,
+    .swap_rand = PUSH_ARRAY_NZ(arena, u32, num_samples),
+  };
+
+  if (!source.order || !source.swap_rand) {
+    fprintf(stderr, "Out of memory for the shuffle order\n");
+    return false;
+  }
+
+  for (u32 i = 0; i < num_samples; i++) {
+    source.order[i] = i;
+  }
+
+  prng_lanes_seed(&source.rng, desc->seed, 2);
+
+  // the descriptors and matrix headers the prefetch thread walks stay packed together
+  mem_pool batch_pool, header_pool;
+  POOL_INIT_STRUCT(&batch_pool, arena, mnist_batch);
+  POOL_INIT_STRUCT(&header_pool, arena, matrix);
+
+  // each slot's data in an arena of its own, so the pages the producer is writing
+  // never share a cache line with the batch the training step is reading
+  mem_arena_desc slot_desc = {
+    .reserve_size = MiB(1),
+    .commit_size = KiB(256),
+    .flags = ARENA_FLAG_CHAINED,
+  };
+  mem_arena* slot_arenas[TRAIN_PREFETCH_DEPTH] = { NULL };
+  void* slots[TRAIN_PREFETCH_DEPTH];
+  b32 slots_ok = true;
+
+  for (u32 i = 0; i < TRAIN_PREFETCH_DEPTH && slots_ok; i++) {
+    mnist_batch* batch = POOL_ALLOC_STRUCT(&batch_pool, mnist_batch);
+    slot_arenas[i] = arena_create_ex(&slot_desc);
+
+    if (batch && slot_arenas[i]) {
+      batch->images = create_matrix_pooled(&header_pool, slot_arenas[i], batch_size, train_images->cols, MATRIX_INIT_UNINIT);
+      batch->labels = create_matrix_pooled(&header_pool, slot_arenas[i], batch_size, train_labels->cols, MATRIX_INIT_UNINIT);
+    }
+
+    slots_ok = batch && slot_arenas[i] && batch->images && batch->labels;
+    slots[i] = batch;
+  }
+
+  prefetch_ring* ring = NULL;
+  if (!slots_ok) {
+    fprintf(stderr, "Out of memory for the prefetched batches\n");
+  } else {
+    ring = prefetch_ring_create(slots, TRAIN_PREFETCH_DEPTH, _fill_batch, &source, (u64)desc->epochs * num_batches);
+
+    if (!ring) {
+      fprintf(stderr, "Failed to start the batch prefetcher\n");
+    }
+  }
+
+  if (!ring) {
+    for (u32 i = 0; i < TRAIN_PREFETCH_DEPTH; i++) {
+      if (slot_arenas[i]) { arena_destroy(slot_arenas[i]); }
+    }
+    return false;
+  }
+
+  // the inputs are leaves, so the program reads them wherever they point
+  f32* input_data = model->input->val->data;
+  f32* labels_data = model->labels->val->data;
+
+  for (u32 epoch = 0; epoch < desc->epochs; epoch++) {
+    f64 loss_sum = 0.0;
+    u64 start = plat_get_time_ns();
+
+    for (u32 batch = 0; batch < num_batches; batch++) {
+      mem_arena_temp step = arena_temp_begin(arena);
+
+      mnist_batch* next = (mnist_batch*)prefetch_ring_acquire(ring);
+      model->input->val->data = next->images->data;
+      model->labels->val->data = next->labels->data;
+
+      model_prog_compute(&model->train_prog);
+      model_prog_compute_grads(&model->train_prog);
+
+      for (u32 i = 0; i < model->num_params; i++) {
+        matrix* val = model->params[i]->val;
+        matrix* grad = model->params[i]->grad;
+        u64 size = (u64)val->rows * val->cols;
+
+        for (u64 j = 0; j < size; j++) {
+          val->data[j] -= desc->learning_rate * grad->data[j];
+        }
+      }
+
+      for (u32 i = 0; i < batch_size; i++) {
+        loss_sum += model->cost->val->data[i];
+      }
+
+      model->input->val->data = input_data;
+      model->labels->val->data = labels_data;
+      prefetch_ring_release(ring);
+
+      arena_temp_end(step);
+    }
+
+    f64 seconds = (plat_get_time_ns() - start) * 1e-9;
+    f32 accuracy = evaluate_accuracy(model, test_images, test_labels);
+
+    printf(
+      "epoch %u: loss %.4f, %.0f samples/s, test accuracy %.2f%%\n",
+      epoch + 1, loss_sum / ((f64)num_batches * batch_size),
+      (f64)num_batches * batch_size / seconds, accuracy * 100.0f
+    );
+  }
+
+  prefetch_ring_destroy(ring);
+
+  for (u32 i = 0; i < TRAIN_PREFETCH_DEPTH; i++) {
+    arena_destroy(slot_arenas[i]);
+  }
+
+  return true;
+}
@@ -26,6 +26,10 @@ train_ds, test_ds = tfds.load("mnist", split=["train", "test"], as_supervised=Tr
 train_images, train_labels = dsTonp(train_ds)
 test_images, test_labels = dsTonp(test_ds)
 
+# raw pixels, the program prefers these and scales them by 1/255 per batch
+train_images.astype(np.uint8).tofile("train_images_u8.mat")
+test_images.astype(np.uint8).tofile("test_images_u8.mat")
+
 train_images = train_images.astype(np.float32) / 255.0
 test_images = test_images.astype(np.float32) / 255.0
 
@@ -33,3 +33,302 @@ f32 prng_randf_r(prng_state* rng) {
 f32 prng_randf(void) {
     return prng_randf_r(&s_prng_state);
 }
+
+#define PRNG_MULTIPLIER 6364136223846793005ULL
+
+void prng_lanes_seed(prng_lanes* rng, u64 initstate, u64 initseq) {
+    prng_state seeder;
+    prng_seed_r(&seeder, initstate, initseq);
+
+    for (u32 i = 0; i < PRNG_LANES; i++) {
+        u64 state = (u64)prng_rand_r(&seeder) << 32;
+        state |= prng_rand_r(&seeder);
+
+        prng_state lane;
+        prng_seed_r(&lane, state, initseq * PRNG_LANES + i);
+
+        rng->state[i] = lane.state;
+        rng->inc[i] = lane.inc;
+    }
+}
+
+// One step of every lane, out[i] from lane i
+static void prng_lanes_step_scalar(prng_lanes* rng, u32* out) {
+    for (u32 i = 0; i < PRNG_LANES; i++) {
+        prng_state lane = { rng->state[i], rng->inc[i] };
+        out[i] = prng_rand_r(&lane);
+        rng->state[i] = lane.state;
+    }
+}
+
+// 2^-24, the top 24 bits of a u32 become an exact f32 in [0, 1)
+#define PRNG_F32_SCALE 5.9604644775390625e-8f
+
+static void prng_fill_u32_scalar(prng_lanes* rng, u32* out, u64 n) {
+    u64 i = 0;
+
+    for (; i + PRNG_LANES <= n; i += PRNG_LANES) {
+        prng_lanes_step_scalar(rng, out + i);
+    }
+
+    if (i < n) {
+        u32 tail[PRNG_LANES];
+        prng_lanes_step_scalar(rng, tail);
+        memcpy(out + i, tail, (n - i) * sizeof(u32));
+    }
+}
+
+static void prng_fill_f32_scalar(prng_lanes* rng, f32* out, u64 n, f32 lo, f32 hi) {
+    f32 range = hi - lo;
+    u32 values[PRNG_LANES];
+
+    for (u64 i = 0; i < n; i += PRNG_LANES) {
+        prng_lanes_step_scalar(rng, values);
+
+        u64 count = MIN(PRNG_LANES, n - i);
+        for (u64 j = 0; j < count; j++) {
+            // fmaf so the result matches the FMA in the SIMD paths bit for bit
+            out[i + j] = fmaf((f32)(values[j] >> 8) * PRNG_F32_SCALE, range, lo);
+        }
+    }
+}
+
+#if CPU_X86
+
+// 64 bit lanes times the multiplier, from 32 bit products since there's no vpmullq before AVX-512DQ
+__attribute__((target("avx2")))
+static __m256i prng_mul_avx2(__m256i x) {
+    const __m256i m_lo = _mm256_set1_epi64x(PRNG_MULTIPLIER & 0xffffffff);
+    const __m256i m_hi = _mm256_set1_epi64x(PRNG_MULTIPLIER >> 32);
+
+    __m256i lo = _mm256_mul_epu32(x, m_lo);
+    __m256i cross = _mm256_add_epi64(
+        _mm256_mul_epu32(_mm256_srli_epi64(x, 32), m_lo),
+        _mm256_mul_epu32(x, m_hi)
+    );
+
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+// pcg32's output for four states, in the low half of each 64 bit lane
+__attribute__((target("avx2")))
+static __m256i prng_output_avx2(__m256i state) {
+    const __m256i low_mask = _mm256_set1_epi64x(0xffffffff);
+
+    __m256i x = _mm256_srli_epi64(_mm256_xor_si256(_mm256_srli_epi64(state, 18), state), 27);
+    x = _mm256_and_si256(x, low_mask);
+    __m256i rot = _mm256_srli_epi64(state, 59);
+    __m256i rot_left = _mm256_sub_epi64(_mm256_set1_epi64x(32), rot);
+
+    return _mm256_or_si256(_mm256_srlv_epi64(x, rot), _mm256_sllv_epi64(x, rot_left));
+}
+
+// Steps all 16 lanes, 4 per register, and returns their outputs as two registers of 8
+__attribute__((target("avx2")))
+static void prng_step_avx2(__m256i state[4], const __m256i inc[4], __m256i out[2]) {
+    const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+
+    __m256i r[4];
+    for (u32 i = 0; i < 4; i++) {
+        r[i] = _mm256_permutevar8x32_epi32(prng_output_avx2(state[i]), even);
+        state[i] = _mm256_add_epi64(prng_mul_avx2(state[i]), inc[i]);
+    }
+
+    out[0] = _mm256_blend_epi32(r[0], r[1], 0xf0);
+    out[1] = _mm256_blend_epi32(r[2], r[3], 0xf0);
+}
+
+__attribute__((target("avx2")))
+static void prng_fill_u32_avx2(prng_lanes* rng, u32* out, u64 n) {
+    __m256i state[4], inc[4];
+    for (u32 i = 0; i < 4; i++) {
+        state[i] = _mm256_loadu_si256((const __m256i*)&rng->state[i * 4]);
+        inc[i] = _mm256_loadu_si256((const __m256i*)&rng->inc[i * 4]);
+    }
+
+    u64 i = 0;
+    __m256i values[2];
+
+    for (; i + PRNG_LANES <= n; i += PRNG_LANES) {
+        prng_step_avx2(state, inc, values);
+        _mm256_storeu_si256((__m256i*)(out + i), values[0]);
+        _mm256_storeu_si256((__m256i*)(out + i + 8), values[1]);
+    }
+
+    if (i < n) {
+        u32 tail[PRNG_LANES];
+        prng_step_avx2(state, inc, values);
+        _mm256_storeu_si256((__m256i*)tail, values[0]);
+        _mm256_storeu_si256((__m256i*)(tail + 8), values[1]);
+        memcpy(out + i, tail, (n - i) * sizeof(u32));
+    }
+
+    for (u32 j = 0; j < 4; j++) {
+        _mm256_storeu_si256((__m256i*)&rng->state[j * 4], state[j]);
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static __m256 prng_to_f32_avx2(__m256i values, __m256 range, __m256 lo) {
+    __m256 u = _mm256_mul_ps(
+        _mm256_cvtepi32_ps(_mm256_srli_epi32(values, 8)),
+        _mm256_set1_ps(PRNG_F32_SCALE)
+    );
+
+    return _mm256_fmadd_ps(u, range, lo);
+}
+
+__attribute__((target("avx2,fma")))
+static void prng_fill_f32_avx2(prng_lanes* rng, f32* out, u64 n, f32 lo, f32 hi) {
+    __m256i state[4], inc[4];
+    for (u32 i = 0; i < 4; i++) {
+        state[i] = _mm256_loadu_si256((const __m256i*)&rng->state[i * 4]);
+        inc[i] = _mm256_loadu_si256((const __m256i*)&rng->inc[i * 4]);
+    }
+
+    __m256 range8 = _mm256_set1_ps(hi - lo);
+    __m256 lo8 = _mm256_set1_ps(lo);
+
+    u64 i = 0;
+    __m256i values[2];
+
+    for (; i + PRNG_LANES <= n; i += PRNG_LANES) {
+        prng_step_avx2(state, inc, values);
+        _mm256_storeu_ps(out + i, prng_to_f32_avx2(values[0], range8, lo8));
+        _mm256_storeu_ps(out + i + 8, prng_to_f32_avx2(values[1], range8, lo8));
+    }
+
+    if (i < n) {
+        f32 tail[PRNG_LANES];
+        prng_step_avx2(state, inc, values);
+        _mm256_storeu_ps(tail, prng_to_f32_avx2(values[0], range8, lo8));
+        _mm256_storeu_ps(tail + 8, prng_to_f32_avx2(values[1], range8, lo8));
+        memcpy(out + i, tail, (n - i) * sizeof(f32));
+    }
+
+    for (u32 j = 0; j < 4; j++) {
+        _mm256_storeu_si256((__m256i*)&rng->state[j * 4], state[j]);
+    }
+}
+
+__attribute__((target("avx512f")))
+static __m512i prng_mul_avx512(__m512i x) {
+    const __m512i m_lo = _mm512_set1_epi64(PRNG_MULTIPLIER & 0xffffffff);
+    const __m512i m_hi = _mm512_set1_epi64(PRNG_MULTIPLIER >> 32);
+
+    __m512i lo = _mm512_mul_epu32(x, m_lo);
+    __m512i cross = _mm512_add_epi64(
+        _mm512_mul_epu32(_mm512_srli_epi64(x, 32), m_lo),
+        _mm512_mul_epu32(x, m_hi)
+    );
+
+    return _mm512_add_epi64(lo, _mm512_slli_epi64(cross, 32));
+}
+
+// Steps all 16 lanes, 8 per register, and returns their outputs in lane order
+__attribute__((target("avx512f")))
+static __m512i prng_step_avx512(__m512i state[2], const __m512i inc[2]) {
+    __m256i r[2];
+
+    for (u32 i = 0; i < 2; i++) {
+        __m512i s = state[i];
+        __m512i x = _mm512_srli_epi64(_mm512_xor_si512(_mm512_srli_epi64(s, 18), s), 27);
+        __m512i rot = _mm512_srli_epi64(s, 59);
+
+        // The 32 bit rotate does the whole permutation once x is narrowed
+        r[i] = _mm512_cvtepi64_epi32(x);
+        r[i] = _mm256_or_si256(
+            _mm256_srlv_epi32(r[i], _mm512_cvtepi64_epi32(rot)),
+            _mm256_sllv_epi32(r[i], _mm256_sub_epi32(_mm256_set1_epi32(32), _mm512_cvtepi64_epi32(rot)))
+        );
+
+        state[i] = _mm512_add_epi64(prng_mul_avx512(s), inc[i]);
+    }
+
+    return _mm512_inserti64x4(_mm512_castsi256_si512(r[0]), r[1], 1);
+}
+
+__attribute__((target("avx512f")))
+static void prng_fill_u32_avx512(prng_lanes* rng, u32* out, u64 n) {
+    __m512i state[2], inc[2];
+    for (u32 i = 0; i < 2; i++) {
+        state[i] = _mm512_loadu_si512(&rng->state[i * 8]);
+        inc[i] = _mm512_loadu_si512(&rng->inc[i * 8]);
+    }
+
+    u64 i = 0;
+
+    for (; i + PRNG_LANES <= n; i += PRNG_LANES) {
+        _mm512_storeu_si512(out + i, prng_step_avx512(state, inc));
+    }
+
+    if (i < n) {
+        __mmask16 mask = (__mmask16)((1u << (n - i)) - 1);
+        _mm512_mask_storeu_epi32(out + i, mask, prng_step_avx512(state, inc));
+    }
+
+    for (u32 j = 0; j < 2; j++) {
+        _mm512_storeu_si512(&rng->state[j * 8], state[j]);
+    }
+}
+
+__attribute__((target("avx512f")))
+static void prng_fill_f32_avx512(prng_lanes* rng, f32* out, u64 n, f32 lo, f32 hi) {
+    __m512i state[2], inc[2];
+    for (u32 i = 0; i < 2; i++) {
+        state[i] = _mm512_loadu_si512(&rng->state[i * 8]);
+        inc[i] = _mm512_loadu_si512(&rng->inc[i * 8]);
+    }
+
+    __m512 range16 = _mm512_set1_ps(hi - lo);
+    __m512 lo16 = _mm512_set1_ps(lo);
+    __m512 scale = _mm512_set1_ps(PRNG_F32_SCALE);
+
+    for (u64 i = 0; i < n; i += PRNG_LANES) {
+        __m512i values = prng_step_avx512(state, inc);
+        __m512 u = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_srli_epi32(values, 8)), scale);
+        __m512 x = _mm512_fmadd_ps(u, range16, lo16);
+
+        if (i + PRNG_LANES <= n) {
+            _mm512_storeu_ps(out + i, x);
+        } else {
+            _mm512_mask_storeu_ps(out + i, (__mmask16)((1u << (n - i)) - 1), x);
+        }
+    }
+
+    for (u32 j = 0; j < 2; j++) {
+        _mm512_storeu_si512(&rng->state[j * 8], state[j]);
+    }
+}
+
+#endif // CPU_X86
+
+void prng_fill_u32(prng_lanes* rng, u32* out, u64 n) {
+#if CPU_X86
+    if (cpu_has(CPU_FEATURE_AVX512F)) {
+        prng_fill_u32_avx512(rng, out, n);
+        return;
+    }
+    if (cpu_has(CPU_FEATURE_AVX2)) {
+        prng_fill_u32_avx2(rng, out, n);
+        return;
+    }
+#endif
+
+    prng_fill_u32_scalar(rng, out, n);
+}
+
+void prng_fill_f32(prng_lanes* rng, f32* out, u64 n, f32 lo, f32 hi) {
+#if CPU_X86
+    if (cpu_has(CPU_FEATURE_AVX512F)) {
+        prng_fill_f32_avx512(rng, out, n, lo, hi);
+        return;
+    }
+    if (cpu_has(CPU_FEATURE_AVX2 | CPU_FEATURE_FMA)) {
+        prng_fill_f32_avx2(rng, out, n, lo, hi);
+        return;
+    }
+#endif
+
+    prng_fill_f32_scalar(rng, out, n, lo, hi);
+}
@@ -14,3 +14,21 @@ u32 prng_rand(void);
 
 f32 prng_randf_r(prng_state* rng);
 f32 prng_randf(void);
+
+// PRNG_LANES independent pcg32 streams stepped together, for filling whole buffers.
+// Element i of a fill comes from lane i % PRNG_LANES, so the output only depends on
+// the seed, never on which SIMD path ran. Every fill advances all lanes by
+// ceil(n / PRNG_LANES) steps, the leftover values of the last step are dropped.
+#define PRNG_LANES 16
+
+typedef struct {
+    u64 state[PRNG_LANES];
+    u64 inc[PRNG_LANES];
+} prng_lanes;
+
+// Lane i is stream initseq * PRNG_LANES + i, its starting state drawn from a pcg32 seeded with both
+void prng_lanes_seed(prng_lanes* rng, u64 initstate, u64 initseq);
+
+void prng_fill_u32(prng_lanes* rng, u32* out, u64 n);
+// Uniform in [lo, hi) from the top 24 bits of each value, lo + u * (hi - lo) with one rounding
+void prng_fill_f32(prng_lanes* rng, f32* out, u64 n, f32 lo, f32 hi);
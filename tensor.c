@@ -0,0 +1,268 @@
+#include <stddef.h>
+
+#define XXH64_PRIME1 0x9e3779b185ebca87ull
+#define XXH64_PRIME2 0xc2b2ae3d27d4eb4full
+#define XXH64_PRIME3 0x165667b19e3779f9ull
+#define XXH64_PRIME4 0x85ebca77c2b2ae63ull
+#define XXH64_PRIME5 0x27d4eb2f165667c5ull
+
+static u64 xxh64_rotl(u64 x, u32 r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static u64 xxh64_read_u64(const u8* p) {
+    u64 x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+static u32 xxh64_read_u32(const u8* p) {
+    u32 x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+static u64 xxh64_round(u64 acc, u64 input) {
+    acc += input * XXH64_PRIME2;
+    acc = xxh64_rotl(acc, 31);
+    return acc * XXH64_PRIME1;
+}
+
+static u64 xxh64_merge(u64 h, u64 acc) {
+    h ^= xxh64_round(0, acc);
+    return h * XXH64_PRIME1 + XXH64_PRIME4;
+}
+
+// Four independent lanes over 32 byte stripes, so the multiplies overlap
+static void xxh64_stripes_scalar(u64 v[4], const u8* p, u64 num_stripes) {
+    for (u64 i = 0; i < num_stripes; i++, p += 32) {
+        v[0] = xxh64_round(v[0], xxh64_read_u64(p));
+        v[1] = xxh64_round(v[1], xxh64_read_u64(p + 8));
+        v[2] = xxh64_round(v[2], xxh64_read_u64(p + 16));
+        v[3] = xxh64_round(v[3], xxh64_read_u64(p + 24));
+    }
+}
+
+#if CPU_X86
+
+// 64 bit lanes times a constant, from 32 bit products since there's no vpmullq before AVX-512DQ
+__attribute__((target("avx2")))
+static __m256i xxh64_mul_avx2(__m256i x, u64 m) {
+    const __m256i m_lo = _mm256_set1_epi64x((i64)(m & 0xffffffff));
+    const __m256i m_hi = _mm256_set1_epi64x((i64)(m >> 32));
+
+    __m256i lo = _mm256_mul_epu32(x, m_lo);
+    __m256i cross = _mm256_add_epi64(
+        _mm256_mul_epu32(_mm256_srli_epi64(x, 32), m_lo),
+        _mm256_mul_epu32(x, m_hi)
+    );
+
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+// The four lanes side by side in one register, a whole stripe per round
+__attribute__((target("avx2")))
+static void xxh64_stripes_avx2(u64 v[4], const u8* p, u64 num_stripes) {
+    __m256i acc = _mm256_loadu_si256((const __m256i*)v);
+
+    for (u64 i = 0; i < num_stripes; i++, p += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i*)p);
+
+        acc = _mm256_add_epi64(acc, xxh64_mul_avx2(input, XXH64_PRIME2));
+        acc = _mm256_or_si256(_mm256_slli_epi64(acc, 31), _mm256_srli_epi64(acc, 33));
+        acc = xxh64_mul_avx2(acc, XXH64_PRIME1);
+    }
+
+    _mm256_storeu_si256((__m256i*)v, acc);
+}
+
+#endif // CPU_X86
+
+u64 xxh64(const void* data, u64 size, u64 seed) {
+    const u8* p = (const u8*)data;
+    const u8* end = p + size;
+    u64 h;
+
+    if (size >= 32) {
+        u64 v[4] = {
+            seed + XXH64_PRIME1 + XXH64_PRIME2,
+            seed + XXH64_PRIME2,
+            seed,
+            seed - XXH64_PRIME1,
+        };
+        u64 num_stripes = size / 32;
+
+#if CPU_X86
+        if (cpu_has(CPU_FEATURE_AVX2)) {
+            xxh64_stripes_avx2(v, p, num_stripes);
+        } else {
+            xxh64_stripes_scalar(v, p, num_stripes);
+        }
+#else
+        xxh64_stripes_scalar(v, p, num_stripes);
+#endif
+        p += num_stripes * 32;
+
+        h = xxh64_rotl(v[0], 1) + xxh64_rotl(v[1], 7) + xxh64_rotl(v[2], 12) + xxh64_rotl(v[3], 18);
+        h = xxh64_merge(h, v[0]);
+        h = xxh64_merge(h, v[1]);
+        h = xxh64_merge(h, v[2]);
+        h = xxh64_merge(h, v[3]);
+    } else {
+        h = seed + XXH64_PRIME5;
+    }
+
+    h += size;
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= xxh64_round(0, xxh64_read_u64(p));
+        h = xxh64_rotl(h, 27) * XXH64_PRIME1 + XXH64_PRIME4;
+    }
+    if (p + 4 <= end) {
+        h ^= (u64)xxh64_read_u32(p) * XXH64_PRIME1;
+        h = xxh64_rotl(h, 23) * XXH64_PRIME2 + XXH64_PRIME3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= *p * XXH64_PRIME5;
+        h = xxh64_rotl(h, 11) * XXH64_PRIME1;
+    }
+
+    h ^= h >> 33;
+    h *= XXH64_PRIME2;
+    h ^= h >> 29;
+    h *= XXH64_PRIME3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+u32 tensor_dtype_size(tensor_dtype dtype) {
+    switch (dtype) {
+        case TENSOR_DTYPE_U8: return 1;
+        case TENSOR_DTYPE_F32: return 4;
+    }
+
+    return 0;
+}
+
+static u64 tensor_header_checksum(const tensor_header* header) {
+    return xxh64(header, offsetof(tensor_header, header_checksum), 0);
+}
+
+b32 tensor_file_write(const char* filename, tensor_dtype dtype, u32 num_dims, const u64* dims, const void* data) {
+    if (tensor_dtype_size(dtype) == 0 || num_dims == 0 || num_dims > TENSOR_MAX_DIMS) {
+        return false;
+    }
+
+    tensor_header header = { .magic = { 'T', 'N', 'S', 'R' } };
+    header.version = TENSOR_FILE_VERSION;
+    header.dtype = dtype;
+    header.num_dims = num_dims;
+
+    u64 count = 1;
+    for (u32 i = 0; i < num_dims; i++) {
+        header.dims[i] = dims[i];
+        count *= dims[i];
+    }
+
+    header.data_offset = ALIGN_UP_POW2(sizeof(tensor_header), TENSOR_DATA_ALIGN);
+    header.data_size = count * tensor_dtype_size(dtype);
+    header.data_checksum = xxh64(data, header.data_size, 0);
+    header.header_checksum = tensor_header_checksum(&header);
+
+    FILE* f = fopen(filename, "wb");
+    if (!f) {
+        fprintf(stderr, "Failed to open %s for writing\n", filename);
+        return false;
+    }
+
+    u8 padding[TENSOR_DATA_ALIGN] = { 0 };
+    u64 padding_size = header.data_offset - sizeof(tensor_header);
+
+    b32 ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+             fwrite(padding, 1, padding_size, f) == padding_size &&
+             fwrite(data, 1, header.data_size, f) == header.data_size;
+
+    ok = (fclose(f) == 0) && ok;
+
+    if (!ok) {
+        fprintf(stderr, "Failed to write %s\n", filename);
+        remove(filename);
+    }
+
+    return ok;
+}
+
+static b32 tensor_validate(const tensor_header* header, u64 file_size, const char* filename) {
+    if (file_size < sizeof(tensor_header) || memcmp(header->magic, "TNSR", 4) != 0) {
+        fprintf(stderr, "%s is not a tensor file\n", filename);
+        return false;
+    }
+    if (header->version != TENSOR_FILE_VERSION) {
+        fprintf(stderr, "%s has version %u, expected %u\n", filename, header->version, TENSOR_FILE_VERSION);
+        return false;
+    }
+    if (header->header_checksum != tensor_header_checksum(header)) {
+        fprintf(stderr, "%s has a corrupt header\n", filename);
+        return false;
+    }
+
+    u32 dtype_size = tensor_dtype_size((tensor_dtype)header->dtype);
+    if (dtype_size == 0 || header->num_dims == 0 || header->num_dims > TENSOR_MAX_DIMS) {
+        fprintf(stderr, "%s has an unsupported type or shape\n", filename);
+        return false;
+    }
+
+    u64 count = 1;
+    for (u32 i = 0; i < header->num_dims; i++) {
+        if (header->dims[i] != 0 && count > UINT64_MAX / 2 / header->dims[i] / dtype_size) {
+            fprintf(stderr, "%s has an unsupported type or shape\n", filename);
+            return false;
+        }
+        count *= header->dims[i];
+    }
+
+    if (header->data_size != count * dtype_size ||
+        header->data_offset % TENSOR_DATA_ALIGN != 0 ||
+        header->data_offset < sizeof(tensor_header) ||
+        header->data_offset > file_size ||
+        file_size - header->data_offset != header->data_size) {
+        fprintf(stderr, "%s is %llu bytes, which doesn't match its header\n", filename, (unsigned long long)file_size);
+        return false;
+    }
+
+    return true;
+}
+
+b32 tensor_file_open(tensor_file* file, const char* filename, u32 map_flags, b32 verify_data) {
+    *file = (tensor_file){ 0 };
+
+    if (!plat_file_map(&file->mapping, filename, map_flags)) {
+        return false;
+    }
+
+    if (file->mapping.size >= sizeof(tensor_header)) {
+        memcpy(&file->header, file->mapping.data, sizeof(tensor_header));
+    }
+
+    if (!tensor_validate(&file->header, file->mapping.size, filename)) {
+        tensor_file_close(file);
+        return false;
+    }
+
+    file->data = (const u8*)file->mapping.data + file->header.data_offset;
+
+    if (verify_data && xxh64(file->data, file->header.data_size, 0) != file->header.data_checksum) {
+        fprintf(stderr, "%s is corrupt, its checksum doesn't match\n", filename);
+        tensor_file_close(file);
+        return false;
+    }
+
+    return true;
+}
+
+void tensor_file_close(tensor_file* file) {
+    plat_file_unmap(&file->mapping);
+    file->data = NULL;
+}
@@ -0,0 +1,51 @@
+// Self-describing tensor files
+//
+// A little-endian header with the element type and shape, then the elements
+// in row-major order at a 64 byte aligned offset, so a mapping of the file
+// can be used in place. Header and payload both carry an XXH64 checksum.
+
+#define TENSOR_FILE_VERSION 1
+#define TENSOR_MAX_DIMS 4
+#define TENSOR_DATA_ALIGN 64
+
+typedef enum {
+    TENSOR_DTYPE_U8 = 1,
+    TENSOR_DTYPE_F32 = 2,
+} tensor_dtype;
+
+typedef struct {
+    // "TNSR"
+    u8 magic[4];
+    u32 version;
+    u32 dtype;
+    u32 num_dims;
+    // Unused dims are 0
+    u64 dims[TENSOR_MAX_DIMS];
+
+    u64 data_offset;
+    u64 data_size;
+    u64 data_checksum;
+
+    // Of every byte before it
+    u64 header_checksum;
+} tensor_header;
+
+typedef struct {
+    tensor_header header;
+    // Points into the mapping
+    const void* data;
+
+    file_mapping mapping;
+} tensor_file;
+
+// XXH64, the same values as the reference implementation, stripes four lanes wide with AVX2
+u64 xxh64(const void* data, u64 size, u64 seed);
+
+u32 tensor_dtype_size(tensor_dtype dtype);
+
+b32 tensor_file_write(const char* filename, tensor_dtype dtype, u32 num_dims, const u64* dims, const void* data);
+// Maps filename and validates the header against the file size.
+// With verify_data the payload checksum is checked too, which reads the whole file.
+// Quietly returns false when the file doesn't exist, anything else is reported on stderr.
+b32 tensor_file_open(tensor_file* file, const char* filename, u32 map_flags, b32 verify_data);
+void tensor_file_close(tensor_file* file);
@@ -0,0 +1,456 @@
+#if defined(_WIN32)
+
+#include <windows.h>
+
+typedef HANDLE plat_thread;
+typedef SRWLOCK plat_mutex;
+typedef CONDITION_VARIABLE plat_cond;
+
+#define PLAT_THREAD_PROC(name, arg) DWORD WINAPI name(LPVOID arg)
+typedef LPTHREAD_START_ROUTINE plat_thread_proc;
+
+#elif defined(__linux__)
+
+#include <pthread.h>
+#include <unistd.h>
+
+typedef pthread_t plat_thread;
+typedef pthread_mutex_t plat_mutex;
+typedef pthread_cond_t plat_cond;
+
+#define PLAT_THREAD_PROC(name, arg) void* name(void* arg)
+typedef void* (*plat_thread_proc)(void*);
+
+#endif
+
+static b32 plat_thread_create(plat_thread* thread, plat_thread_proc proc, void* arg);
+static void plat_thread_join(plat_thread thread);
+static void plat_mutex_init(plat_mutex* mutex);
+static void plat_mutex_destroy(plat_mutex* mutex);
+static void plat_mutex_lock(plat_mutex* mutex);
+static void plat_mutex_unlock(plat_mutex* mutex);
+static void plat_cond_init(plat_cond* cond);
+static void plat_cond_destroy(plat_cond* cond);
+static void plat_cond_wait(plat_cond* cond, plat_mutex* mutex);
+static void plat_cond_broadcast(plat_cond* cond);
+
+// One cache line per worker so range updates don't false share
+typedef struct {
+    u64 next;
+    u64 end;
+    u8 pad[48];
+} thread_pool_slot;
+
+typedef struct {
+    thread_pool* pool;
+    u32 index;
+} thread_pool_worker;
+
+struct thread_pool {
+    mem_arena* arena;
+
+    u32 num_threads;
+    plat_thread* threads;
+    thread_pool_worker* workers;
+    thread_pool_slot* slots;
+
+    plat_mutex mutex;
+    plat_cond work_cond;
+    plat_cond done_cond;
+
+    u64 generation;
+    u32 pending;
+    b32 shutdown;
+
+    thread_task_fn* fn;
+    void* ctx;
+};
+
+static void thread_pool_work(thread_pool* pool, u32 worker) {
+    for (u32 i = 0; i < pool->num_threads; i++) {
+        thread_pool_slot* slot = &pool->slots[(worker + i) % pool->num_threads];
+
+        while (true) {
+            u64 task = __atomic_fetch_add(&slot->next, 1, __ATOMIC_RELAXED);
+            if (task >= slot->end) { break; }
+
+            pool->fn(pool->ctx, task, worker);
+        }
+    }
+}
+
+static PLAT_THREAD_PROC(thread_pool_worker_proc, arg) {
+    thread_pool_worker* worker = (thread_pool_worker*)arg;
+    thread_pool* pool = worker->pool;
+
+    u64 seen_generation = 0;
+
+    while (true) {
+        plat_mutex_lock(&pool->mutex);
+
+        while (pool->generation == seen_generation && !pool->shutdown) {
+            plat_cond_wait(&pool->work_cond, &pool->mutex);
+        }
+
+        if (pool->shutdown) {
+            plat_mutex_unlock(&pool->mutex);
+            break;
+        }
+
+        seen_generation = pool->generation;
+
+        plat_mutex_unlock(&pool->mutex);
+
+        thread_pool_work(pool, worker->index);
+
+        plat_mutex_lock(&pool->mutex);
+
+        if (--pool->pending == 0) {
+            plat_cond_broadcast(&pool->done_cond);
+        }
+
+        plat_mutex_unlock(&pool->mutex);
+    }
+
+    // Pools get torn down and rebuilt on a resize, their threads' scratch arenas with them
+    arena_scratch_thread_release();
+
+    return 0;
+}
+
+thread_pool* thread_pool_create(u32 num_threads) {
+    num_threads = MAX(num_threads, 1);
+
+    mem_arena* arena = arena_create(MiB(1), KiB(64));
+    if (arena == NULL) { return NULL; }
+
+    thread_pool* pool = PUSH_STRUCT(arena, thread_pool);
+
+    pool->arena = arena;
+    pool->num_threads = num_threads;
+    pool->threads = PUSH_ARRAY(arena, plat_thread, num_threads);
+    pool->workers = PUSH_ARRAY(arena, thread_pool_worker, num_threads);
+    pool->slots = PUSH_ARRAY(arena, thread_pool_slot, num_threads);
+
+    plat_mutex_init(&pool->mutex);
+    plat_cond_init(&pool->work_cond);
+    plat_cond_init(&pool->done_cond);
+
+    // Worker 0 is whichever thread calls thread_pool_run
+    for (u32 i = 1; i < num_threads; i++) {
+        pool->workers[i] = (thread_pool_worker){ .pool = pool, .index = i };
+
+        if (!plat_thread_create(&pool->threads[i], thread_pool_worker_proc, &pool->workers[i])) {
+            pool->num_threads = i;
+            break;
+        }
+    }
+
+    return pool;
+}
+
+void thread_pool_destroy(thread_pool* pool) {
+    plat_mutex_lock(&pool->mutex);
+    pool->shutdown = true;
+    plat_cond_broadcast(&pool->work_cond);
+    plat_mutex_unlock(&pool->mutex);
+
+    for (u32 i = 1; i < pool->num_threads; i++) {
+        plat_thread_join(pool->threads[i]);
+    }
+
+    plat_cond_destroy(&pool->done_cond);
+    plat_cond_destroy(&pool->work_cond);
+    plat_mutex_destroy(&pool->mutex);
+
+    arena_destroy(pool->arena);
+}
+
+void thread_pool_run(thread_pool* pool, thread_task_fn* fn, void* ctx, u64 num_tasks) {
+    if (num_tasks == 0) { return; }
+
+    u32 num_threads = pool->num_threads;
+
+    if (num_threads == 1 || num_tasks == 1) {
+        for (u64 i = 0; i < num_tasks; i++) {
+            fn(ctx, i, 0);
+        }
+        return;
+    }
+
+    plat_mutex_lock(&pool->mutex);
+
+    pool->fn = fn;
+    pool->ctx = ctx;
+
+    for (u32 i = 0; i < num_threads; i++) {
+        pool->slots[i].next = num_tasks * i / num_threads;
+        pool->slots[i].end = num_tasks * (i + 1) / num_threads;
+    }
+
+    pool->pending = num_threads - 1;
+    pool->generation++;
+
+    plat_cond_broadcast(&pool->work_cond);
+    plat_mutex_unlock(&pool->mutex);
+
+    thread_pool_work(pool, 0);
+
+    plat_mutex_lock(&pool->mutex);
+
+    while (pool->pending > 0) {
+        plat_cond_wait(&pool->done_cond, &pool->mutex);
+    }
+
+    plat_mutex_unlock(&pool->mutex);
+}
+
+u32 thread_pool_size(thread_pool* pool) {
+    return pool->num_threads;
+}
+
+typedef struct {
+    u8* data;
+    u64 row_size;
+    u64 pagesize;
+} thread_pool_touch_job;
+
+static void thread_pool_touch_task(void* ctx, u64 task, u32 worker) {
+    (void)worker;
+
+    thread_pool_touch_job* job = (thread_pool_touch_job*)ctx;
+
+    // Writing the byte back faults the page in without changing anything,
+    // a plain read would only map the shared zero page
+    volatile u8* p = job->data + task * job->row_size;
+    volatile u8* end = p + job->row_size;
+
+    while (p < end) {
+        *p = *p;
+        p = (volatile u8*)(ALIGN_UP_POW2((u64)p + 1, job->pagesize));
+    }
+}
+
+void thread_pool_first_touch(thread_pool* pool, void* data, u64 rows, u64 row_size) {
+    thread_pool_touch_job job = {
+        .data = (u8*)data,
+        .row_size = row_size,
+        .pagesize = plat_get_pagesize(),
+    };
+
+    thread_pool_run(pool, thread_pool_touch_task, &job, rows);
+}
+
+// Polls this many times before going to sleep, a slot usually frees up sooner than a wakeup takes
+#define PREFETCH_SPIN_COUNT 256
+
+struct prefetch_ring {
+    mem_arena* arena;
+
+    void** slots;
+    u32 num_slots;
+
+    prefetch_fill_fn* fill;
+    void* ctx;
+    u64 num_items;
+
+    b32 threaded;
+    plat_thread thread;
+
+    // Items filled so far, written by the producer
+    u64 tail;
+    u8 pad0[56];
+    // Items released so far, written by the consumer
+    u64 head;
+    u8 pad1[56];
+
+    u32 sleepers;
+    b32 shutdown;
+
+    plat_mutex mutex;
+    plat_cond cond;
+};
+
+static void prefetch_ring_wake(prefetch_ring* ring) {
+    // Pairs with the sleeper count going up before the sleeper rechecks the ring
+    if (__atomic_load_n(&ring->sleepers, __ATOMIC_SEQ_CST) == 0) { return; }
+
+    plat_mutex_lock(&ring->mutex);
+    plat_cond_broadcast(&ring->cond);
+    plat_mutex_unlock(&ring->mutex);
+}
+
+// True once *value has moved past min, or the ring is shutting down
+static b32 prefetch_ring_ready(prefetch_ring* ring, const u64* value, u64 min) {
+    return __atomic_load_n(value, __ATOMIC_SEQ_CST) > min ||
+           __atomic_load_n(&ring->shutdown, __ATOMIC_SEQ_CST);
+}
+
+static void prefetch_ring_wait(prefetch_ring* ring, const u64* value, u64 min) {
+    for (u32 i = 0; i < PREFETCH_SPIN_COUNT; i++) {
+        if (prefetch_ring_ready(ring, value, min)) { return; }
+#if CPU_X86
+        _mm_pause();
+#endif
+    }
+
+    plat_mutex_lock(&ring->mutex);
+    __atomic_fetch_add(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+
+    while (!prefetch_ring_ready(ring, value, min)) {
+        plat_cond_wait(&ring->cond, &ring->mutex);
+    }
+
+    __atomic_fetch_sub(&ring->sleepers, 1, __ATOMIC_SEQ_CST);
+    plat_mutex_unlock(&ring->mutex);
+}
+
+static PLAT_THREAD_PROC(prefetch_ring_proc, arg) {
+    prefetch_ring* ring = (prefetch_ring*)arg;
+
+    for (u64 item = 0; item < ring->num_items; item++) {
+        // Slot item % num_slots is free once the consumer released item - num_slots
+        if (item >= ring->num_slots) {
+            prefetch_ring_wait(ring, &ring->head, item - ring->num_slots);
+        }
+        if (__atomic_load_n(&ring->shutdown, __ATOMIC_SEQ_CST)) { break; }
+
+        ring->fill(ring->ctx, ring->slots[item % ring->num_slots], item);
+
+        __atomic_store_n(&ring->tail, item + 1, __ATOMIC_SEQ_CST);
+        prefetch_ring_wake(ring);
+    }
+
+    arena_scratch_thread_release();
+
+    return 0;
+}
+
+prefetch_ring* prefetch_ring_create(void** slots, u32 num_slots, prefetch_fill_fn* fill, void* ctx, u64 num_items) {
+    if (num_slots == 0) { return NULL; }
+
+    mem_arena* arena = arena_create(KiB(64), KiB(64));
+    if (arena == NULL) { return NULL; }
+
+    prefetch_ring* ring = PUSH_STRUCT(arena, prefetch_ring);
+
+    ring->arena = arena;
+    ring->slots = PUSH_ARRAY(arena, void*, num_slots);
+    ring->num_slots = num_slots;
+    ring->fill = fill;
+    ring->ctx = ctx;
+    ring->num_items = num_items;
+
+    memcpy(ring->slots, slots, sizeof(void*) * num_slots);
+
+    plat_mutex_init(&ring->mutex);
+    plat_cond_init(&ring->cond);
+
+    ring->threaded = plat_thread_create(&ring->thread, prefetch_ring_proc, ring);
+
+    return ring;
+}
+
+void prefetch_ring_destroy(prefetch_ring* ring) {
+    if (ring->threaded) {
+        plat_mutex_lock(&ring->mutex);
+        __atomic_store_n(&ring->shutdown, true, __ATOMIC_SEQ_CST);
+        plat_cond_broadcast(&ring->cond);
+        plat_mutex_unlock(&ring->mutex);
+
+        plat_thread_join(ring->thread);
+    }
+
+    plat_cond_destroy(&ring->cond);
+    plat_mutex_destroy(&ring->mutex);
+
+    arena_destroy(ring->arena);
+}
+
+void* prefetch_ring_acquire(prefetch_ring* ring) {
+    u64 item = ring->head;
+    if (item >= ring->num_items) { return NULL; }
+
+    void* slot = ring->slots[item % ring->num_slots];
+
+    if (!ring->threaded) {
+        ring->fill(ring->ctx, slot, item);
+        return slot;
+    }
+
+    prefetch_ring_wait(ring, &ring->tail, item);
+
+    return slot;
+}
+
+void prefetch_ring_release(prefetch_ring* ring) {
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_SEQ_CST);
+
+    if (ring->threaded) {
+        prefetch_ring_wake(ring);
+    }
+}
+
+#if defined(_WIN32)
+
+u32 plat_get_core_count(void) {
+    SYSTEM_INFO sysinfo = { 0 };
+    GetSystemInfo(&sysinfo);
+
+    return sysinfo.dwNumberOfProcessors;
+}
+
+static b32 plat_thread_create(plat_thread* thread, plat_thread_proc proc, void* arg) {
+    *thread = CreateThread(NULL, 0, proc, arg, 0, NULL);
+    return *thread != NULL;
+}
+
+static void plat_thread_join(plat_thread thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+static void plat_mutex_init(plat_mutex* mutex) { InitializeSRWLock(mutex); }
+static void plat_mutex_destroy(plat_mutex* mutex) { (void)mutex; }
+static void plat_mutex_lock(plat_mutex* mutex) { AcquireSRWLockExclusive(mutex); }
+static void plat_mutex_unlock(plat_mutex* mutex) { ReleaseSRWLockExclusive(mutex); }
+
+static void plat_cond_init(plat_cond* cond) { InitializeConditionVariable(cond); }
+static void plat_cond_destroy(plat_cond* cond) { (void)cond; }
+
+static void plat_cond_wait(plat_cond* cond, plat_mutex* mutex) {
+    SleepConditionVariableSRW(cond, mutex, INFINITE, 0);
+}
+
+static void plat_cond_broadcast(plat_cond* cond) { WakeAllConditionVariable(cond); }
+
+#elif defined(__linux__)
+
+u32 plat_get_core_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (u32)count : 1;
+}
+
+static b32 plat_thread_create(plat_thread* thread, plat_thread_proc proc, void* arg) {
+    return pthread_create(thread, NULL, proc, arg) == 0;
+}
+
+static void plat_thread_join(plat_thread thread) {
+    pthread_join(thread, NULL);
+}
+
+static void plat_mutex_init(plat_mutex* mutex) { pthread_mutex_init(mutex, NULL); }
+static void plat_mutex_destroy(plat_mutex* mutex) { pthread_mutex_destroy(mutex); }
+static void plat_mutex_lock(plat_mutex* mutex) { pthread_mutex_lock(mutex); }
+static void plat_mutex_unlock(plat_mutex* mutex) { pthread_mutex_unlock(mutex); }
+
+static void plat_cond_init(plat_cond* cond) { pthread_cond_init(cond, NULL); }
+static void plat_cond_destroy(plat_cond* cond) { pthread_cond_destroy(cond); }
+
+static void plat_cond_wait(plat_cond* cond, plat_mutex* mutex) {
+    pthread_cond_wait(cond, mutex);
+}
+
+static void plat_cond_broadcast(plat_cond* cond) { pthread_cond_broadcast(cond); }
+
+#endif
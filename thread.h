@@ -0,0 +1,46 @@
+// Persistent worker pool
+//
+// thread_pool_run splits [0, num_tasks) into one contiguous range per worker,
+// workers that run out of their own range steal from the others.
+// The calling thread takes part as worker 0.
+
+typedef void (thread_task_fn)(void* ctx, u64 task, u32 worker);
+
+typedef struct thread_pool thread_pool;
+
+thread_pool* thread_pool_create(u32 num_threads);
+void thread_pool_destroy(thread_pool* pool);
+
+// Blocks until every task has finished
+void thread_pool_run(thread_pool* pool, thread_task_fn* fn, void* ctx, u64 num_tasks);
+u32 thread_pool_size(thread_pool* pool);
+
+// Touches every page of rows x row_size bytes at data, each row from the worker whose
+// range thread_pool_run would give it first, so with first-touch NUMA placement the
+// pages end up next to the workers of a later pass split the same way.
+// Contents are left as they are. Rows that get stolen land wherever the thief runs.
+void thread_pool_first_touch(thread_pool* pool, void* data, u64 rows, u64 row_size);
+
+// Background producer feeding one consumer through a bounded ring of slots
+//
+// The producer thread fills items 0, 1, 2, ... in order, each into the next free
+// slot, and waits while every slot is full. Handing slots back and forth is
+// lock-free, the mutex is only taken when one side has to sleep on the other.
+// If the thread can't be started, acquire fills each item on the calling thread.
+
+// Writes item into slot, only ever called from one thread at a time
+typedef void (prefetch_fill_fn)(void* ctx, void* slot, u64 item);
+
+typedef struct prefetch_ring prefetch_ring;
+
+// slots belong to the caller and have to outlive the ring
+prefetch_ring* prefetch_ring_create(void** slots, u32 num_slots, prefetch_fill_fn* fill, void* ctx, u64 num_items);
+// Stops the producer, even if it hasn't filled every item
+void prefetch_ring_destroy(prefetch_ring* ring);
+
+// Blocks until the next item is ready and returns its slot, NULL once every item was taken
+void* prefetch_ring_acquire(prefetch_ring* ring);
+// Gives the slot from the last acquire back to the producer
+void prefetch_ring_release(prefetch_ring* ring);
+
+u32 plat_get_core_count(void);
@@ -0,0 +1,29 @@
+#if defined(_WIN32)
+
+#include <windows.h>
+
+u64 plat_get_time_ns(void) {
+    static LARGE_INTEGER frequency = { 0 };
+
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+
+    return (u64)((f64)counter.QuadPart * 1e9 / (f64)frequency.QuadPart);
+}
+
+#elif defined(__linux__)
+
+#include <time.h>
+
+u64 plat_get_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,3 @@
+// Monotonic clock for timing training and benchmarks
+
+u64 plat_get_time_ns(void);
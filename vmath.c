@@ -0,0 +1,522 @@
+#include <float.h>
+
+// Cephes style exp: x = n*ln2 + r with |r| <= ln2/2, e^r from a degree 6 polynomial,
+// 2^n built directly in the exponent bits
+#define VM_EXP_MIN -87.3365447504f
+#define VM_EXP_MAX 88.3762626647f
+#define VM_LOG2E 1.44269504088896341f
+#define VM_LN2_HI 0.693359375f
+#define VM_LN2_LO -2.12194440e-4f
+
+#define VM_EXP_P0 1.9875691500e-4f
+#define VM_EXP_P1 1.3981999507e-3f
+#define VM_EXP_P2 8.3334519073e-3f
+#define VM_EXP_P3 4.1665795894e-2f
+#define VM_EXP_P4 1.6666665459e-1f
+#define VM_EXP_P5 5.0000001201e-1f
+
+f32 vm_expf(f32 x) {
+    x = MIN(MAX(x, VM_EXP_MIN), VM_EXP_MAX);
+
+    f32 n = floorf(x * VM_LOG2E + 0.5f);
+    f32 r = x - n * VM_LN2_HI - n * VM_LN2_LO;
+
+    f32 p = VM_EXP_P0;
+    p = p * r + VM_EXP_P1;
+    p = p * r + VM_EXP_P2;
+    p = p * r + VM_EXP_P3;
+    p = p * r + VM_EXP_P4;
+    p = p * r + VM_EXP_P5;
+    p = p * r * r + r + 1.0f;
+
+    union { u32 u; f32 f; } pow2n = { .u = (u32)((i32)n + 127) << 23 };
+
+    return p * pow2n.f;
+}
+
+// Row max and sum(exp(in - max)) in one pass, the sum is rescaled whenever the max grows
+static f32 vm_max_sum_exp_scalar(const f32* in, u64 n, f32* sum_out) {
+    f32 max = in[0];
+    f32 sum = 1.0f;
+
+    for (u64 i = 1; i < n; i++) {
+        if (in[i] > max) {
+            sum = sum * vm_expf(max - in[i]) + 1.0f;
+            max = in[i];
+        } else {
+            sum += vm_expf(in[i] - max);
+        }
+    }
+
+    *sum_out = sum;
+    return max;
+}
+
+static void vm_softmax_row_scalar(f32* out, const f32* in, u64 n) {
+    f32 sum;
+    f32 max = vm_max_sum_exp_scalar(in, n, &sum);
+    f32 inv_sum = 1.0f / sum;
+
+    for (u64 i = 0; i < n; i++) {
+        out[i] = vm_expf(in[i] - max) * inv_sum;
+    }
+}
+
+static f32 vm_softmax_xent_row_scalar(
+    f32* grad, const f32* logits, const f32* target, u32 target_index, u64 n, f32 grad_scale
+) {
+    f32 sum;
+    f32 max = vm_max_sum_exp_scalar(logits, n, &sum);
+    f32 log_sum_exp = max + logf(sum);
+    f32 loss = 0.0f;
+
+    if (target == NULL) {
+        loss = log_sum_exp - logits[target_index];
+    } else {
+        for (u64 i = 0; i < n; i++) {
+            loss += target[i] * (log_sum_exp - logits[i]);
+        }
+    }
+
+    if (grad != NULL) {
+        f32 scale = grad_scale / sum;
+
+        for (u64 i = 0; i < n; i++) {
+            f32 g = vm_expf(logits[i] - max) * scale;
+            grad[i] = target != NULL ? g - target[i] * grad_scale : g;
+        }
+
+        if (target == NULL) {
+            grad[target_index] -= grad_scale;
+        }
+    }
+
+    return loss;
+}
+
+static void vm_softmax_xent_grad_add_row_scalar(
+    f32* out, const f32* logits, const f32* target, u32 target_index, u64 n, f32 grad_scale
+) {
+    f32 sum;
+    f32 max = vm_max_sum_exp_scalar(logits, n, &sum);
+    f32 scale = grad_scale / sum;
+
+    for (u64 i = 0; i < n; i++) {
+        f32 g = vm_expf(logits[i] - max) * scale;
+        out[i] += target != NULL ? g - target[i] * grad_scale : g;
+    }
+
+    if (target == NULL) {
+        out[target_index] -= grad_scale;
+    }
+}
+
+static void vm_u8_to_f32_scalar(f32* out, const u8* in, u64 n, f32 scale) {
+    for (u64 i = 0; i < n; i++) {
+        out[i] = (f32)in[i] * scale;
+    }
+}
+
+static void vm_relu_grad_add_scalar(f32* out, const f32* in, const f32* grad, u64 n) {
+    for (u64 i = 0; i < n; i++) {
+        out[i] += in[i] > 0.0f ? grad[i] : 0.0f;
+    }
+}
+
+static void vm_softmax_grad_add_row_scalar(f32* out, const f32* s, const f32* grad, u64 n) {
+    f32 dot = 0.0f;
+    for (u64 i = 0; i < n; i++) {
+        dot += grad[i] * s[i];
+    }
+
+    for (u64 i = 0; i < n; i++) {
+        out[i] += s[i] * (grad[i] - dot);
+    }
+}
+
+static void vm_xent_grad_add_scalar(f32* out, const f32* p, const f32* q, const f32* grad, u64 n) {
+    for (u64 i = 0; i < n; i++) {
+        out[i] += p[i] == 0.0f ? 0.0f : -p[i] / q[i] * grad[i];
+    }
+}
+
+#if CPU_X86
+
+__attribute__((target("avx2,fma")))
+static __m256 vm_exp8_avx2(__m256 x) {
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(VM_EXP_MIN)), _mm256_set1_ps(VM_EXP_MAX));
+
+    __m256 n = _mm256_floor_ps(_mm256_fmadd_ps(x, _mm256_set1_ps(VM_LOG2E), _mm256_set1_ps(0.5f)));
+    __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(VM_LN2_HI), x);
+    r = _mm256_fnmadd_ps(n, _mm256_set1_ps(VM_LN2_LO), r);
+
+    __m256 p = _mm256_set1_ps(VM_EXP_P0);
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(VM_EXP_P1));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(VM_EXP_P2));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(VM_EXP_P3));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(VM_EXP_P4));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(VM_EXP_P5));
+    p = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
+
+    __m256i pow2n = _mm256_slli_epi32(
+        _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23
+    );
+
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(pow2n));
+}
+
+// Lanes [0, count) set, for loads and stores of a row's tail
+__attribute__((target("avx2")))
+static __m256i vm_tail_mask_avx2(u64 count) {
+    __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32((i32)count), lanes);
+}
+
+__attribute__((target("avx2")))
+static f32 vm_hmax8_avx2(__m256 v) {
+    __m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_max_ss(m, _mm_movehdup_ps(m));
+    return _mm_cvtss_f32(m);
+}
+
+__attribute__((target("avx2")))
+static f32 vm_hsum8_avx2(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+
+// One step of the online max and sum for each lane. Only one of the two exponents
+// max - x and x - max is non-zero, so a single exp(-|x - max|) covers both cases.
+__attribute__((target("avx2,fma")))
+static void vm_max_sum_exp_step_avx2(__m256* max, __m256* sum, __m256 x) {
+    __m256 diff = _mm256_sub_ps(x, *max);
+    __m256 e = vm_exp8_avx2(_mm256_or_ps(diff, _mm256_set1_ps(-0.0f)));
+    __m256 grew = _mm256_cmp_ps(diff, _mm256_setzero_ps(), _CMP_GT_OQ);
+
+    *sum = _mm256_blendv_ps(_mm256_add_ps(*sum, e), _mm256_fmadd_ps(*sum, e, _mm256_set1_ps(1.0f)), grew);
+    *max = _mm256_max_ps(*max, x);
+}
+
+__attribute__((target("avx2,fma")))
+static f32 vm_max_sum_exp_avx2(const f32* in, u64 n, f32* sum_out) {
+    u64 body = n & ~(u64)7;
+    u64 tail = n - body;
+
+    // finite, so lanes that never see a value don't produce inf - inf
+    __m256 max = _mm256_set1_ps(-FLT_MAX);
+    __m256 sum = _mm256_setzero_ps();
+
+    for (u64 i = 0; i < body; i += 8) {
+        vm_max_sum_exp_step_avx2(&max, &sum, _mm256_loadu_ps(in + i));
+    }
+    if (tail) {
+        __m256 mask = _mm256_castsi256_ps(vm_tail_mask_avx2(tail));
+        __m256 x = _mm256_blendv_ps(max, _mm256_maskload_ps(in + body, _mm256_castps_si256(mask)), mask);
+        __m256 tail_max = max, tail_sum = sum;
+
+        vm_max_sum_exp_step_avx2(&tail_max, &tail_sum, x);
+        max = tail_max;
+        sum = _mm256_blendv_ps(sum, tail_sum, mask);
+    }
+
+    f32 row_max = vm_hmax8_avx2(max);
+    sum = _mm256_mul_ps(sum, vm_exp8_avx2(_mm256_sub_ps(max, _mm256_set1_ps(row_max))));
+
+    *sum_out = vm_hsum8_avx2(sum);
+    return row_max;
+}
+
+__attribute__((target("avx2,fma")))
+static void vm_softmax_row_avx2(f32* out, const f32* in, u64 n) {
+    u64 body = n & ~(u64)7;
+    u64 tail = n - body;
+    __m256i tail_mask = vm_tail_mask_avx2(tail);
+
+    f32 row_sum;
+    __m256 row_max = _mm256_set1_ps(vm_max_sum_exp_avx2(in, n, &row_sum));
+    __m256 inv_sum = _mm256_set1_ps(1.0f / row_sum);
+
+    for (u64 i = 0; i < body; i += 8) {
+        __m256 e = vm_exp8_avx2(_mm256_sub_ps(_mm256_loadu_ps(in + i), row_max));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(e, inv_sum));
+    }
+    if (tail) {
+        __m256 e = vm_exp8_avx2(_mm256_sub_ps(_mm256_maskload_ps(in + body, tail_mask), row_max));
+        _mm256_maskstore_ps(out + body, tail_mask, _mm256_mul_ps(e, inv_sum));
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static f32 vm_softmax_xent_row_avx2(
+    f32* grad, const f32* logits, const f32* target, u32 target_index, u64 n, f32 grad_scale
+) {
+    u64 body = n & ~(u64)7;
+    u64 tail = n - body;
+    __m256i tail_mask = vm_tail_mask_avx2(tail);
+
+    f32 row_sum;
+    f32 row_max = vm_max_sum_exp_avx2(logits, n, &row_sum);
+    f32 log_sum_exp = row_max + logf(row_sum);
+    f32 loss = 0.0f;
+
+    if (target == NULL) {
+        loss = log_sum_exp - logits[target_index];
+    } else {
+        // sum(target * logits) and sum(target), for the loss against a full distribution
+        __m256 dot = _mm256_setzero_ps();
+        __m256 mass = _mm256_setzero_ps();
+
+        for (u64 i = 0; i < body; i += 8) {
+            __m256 t = _mm256_loadu_ps(target + i);
+            dot = _mm256_fmadd_ps(t, _mm256_loadu_ps(logits + i), dot);
+            mass = _mm256_add_ps(mass, t);
+        }
+        if (tail) {
+            __m256 t = _mm256_maskload_ps(target + body, tail_mask);
+            dot = _mm256_fmadd_ps(t, _mm256_maskload_ps(logits + body, tail_mask), dot);
+            mass = _mm256_add_ps(mass, t);
+        }
+
+        loss = log_sum_exp * vm_hsum8_avx2(mass) - vm_hsum8_avx2(dot);
+    }
+
+    if (grad != NULL) {
+        __m256 max8 = _mm256_set1_ps(row_max);
+        __m256 scale = _mm256_set1_ps(grad_scale / row_sum);
+        __m256 t_scale = _mm256_set1_ps(grad_scale);
+
+        for (u64 i = 0; i < body; i += 8) {
+            __m256 g = _mm256_mul_ps(vm_exp8_avx2(_mm256_sub_ps(_mm256_loadu_ps(logits + i), max8)), scale);
+            if (target != NULL) {
+                g = _mm256_fnmadd_ps(_mm256_loadu_ps(target + i), t_scale, g);
+            }
+            _mm256_storeu_ps(grad + i, g);
+        }
+        if (tail) {
+            __m256 x = _mm256_maskload_ps(logits + body, tail_mask);
+            __m256 g = _mm256_mul_ps(vm_exp8_avx2(_mm256_sub_ps(x, max8)), scale);
+            if (target != NULL) {
+                g = _mm256_fnmadd_ps(_mm256_maskload_ps(target + body, tail_mask), t_scale, g);
+            }
+            _mm256_maskstore_ps(grad + body, tail_mask, g);
+        }
+
+        if (target == NULL) {
+            grad[target_index] -= grad_scale;
+        }
+    }
+
+    return loss;
+}
+
+__attribute__((target("avx2,fma")))
+static void vm_softmax_xent_grad_add_row_avx2(
+    f32* out, const f32* logits, const f32* target, u32 target_index, u64 n, f32 grad_scale
+) {
+    u64 body = n & ~(u64)7;
+    u64 tail = n - body;
+    __m256i tail_mask = vm_tail_mask_avx2(tail);
+
+    f32 row_sum;
+    __m256 row_max = _mm256_set1_ps(vm_max_sum_exp_avx2(logits, n, &row_sum));
+    __m256 scale = _mm256_set1_ps(grad_scale / row_sum);
+    __m256 t_scale = _mm256_set1_ps(grad_scale);
+
+    for (u64 i = 0; i < body; i += 8) {
+        __m256 g = _mm256_mul_ps(vm_exp8_avx2(_mm256_sub_ps(_mm256_loadu_ps(logits + i), row_max)), scale);
+        if (target != NULL) {
+            g = _mm256_fnmadd_ps(_mm256_loadu_ps(target + i), t_scale, g);
+        }
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), g));
+    }
+    if (tail) {
+        __m256 x = _mm256_maskload_ps(logits + body, tail_mask);
+        __m256 g = _mm256_mul_ps(vm_exp8_avx2(_mm256_sub_ps(x, row_max)), scale);
+        if (target != NULL) {
+            g = _mm256_fnmadd_ps(_mm256_maskload_ps(target + body, tail_mask), t_scale, g);
+        }
+        _mm256_maskstore_ps(out + body, tail_mask, _mm256_add_ps(_mm256_maskload_ps(out + body, tail_mask), g));
+    }
+
+    if (target == NULL) {
+        out[target_index] -= grad_scale;
+    }
+}
+
+// 32 pixels per iteration, each group of 8 bytes zero extended to 8 i32 lanes
+__attribute__((target("avx2")))
+static void vm_u8_to_f32_avx2(f32* out, const u8* in, u64 n, f32 scale) {
+    u64 body = n & ~(u64)31;
+    __m256 scale8 = _mm256_set1_ps(scale);
+
+    for (u64 i = 0; i < body; i += 32) {
+        __m256i bytes = _mm256_loadu_si256((const __m256i*)(in + i));
+        __m128i lo = _mm256_castsi256_si128(bytes);
+        __m128i hi = _mm256_extracti128_si256(bytes, 1);
+
+        __m256 f0 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(lo));
+        __m256 f1 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8)));
+        __m256 f2 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(hi));
+        __m256 f3 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8)));
+
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(f0, scale8));
+        _mm256_storeu_ps(out + i + 8, _mm256_mul_ps(f1, scale8));
+        _mm256_storeu_ps(out + i + 16, _mm256_mul_ps(f2, scale8));
+        _mm256_storeu_ps(out + i + 24, _mm256_mul_ps(f3, scale8));
+    }
+
+    vm_u8_to_f32_scalar(out + body, in + body, n - body, scale);
+}
+
+__attribute__((target("avx2")))
+static void vm_relu_grad_add_avx2(f32* out, const f32* in, const f32* grad, u64 n) {
+    u64 body = n & ~(u64)7;
+    __m256 zero = _mm256_setzero_ps();
+
+    for (u64 i = 0; i < body; i += 8) {
+        __m256 active = _mm256_cmp_ps(_mm256_loadu_ps(in + i), zero, _CMP_GT_OQ);
+        __m256 g = _mm256_and_ps(_mm256_loadu_ps(grad + i), active);
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), g));
+    }
+
+    vm_relu_grad_add_scalar(out + body, in + body, grad + body, n - body);
+}
+
+__attribute__((target("avx2,fma")))
+static void vm_softmax_grad_add_row_avx2(f32* out, const f32* s, const f32* grad, u64 n) {
+    u64 body = n & ~(u64)7;
+    u64 tail = n - body;
+    __m256i tail_mask = vm_tail_mask_avx2(tail);
+
+    __m256 dot = _mm256_setzero_ps();
+
+    for (u64 i = 0; i < body; i += 8) {
+        dot = _mm256_fmadd_ps(_mm256_loadu_ps(grad + i), _mm256_loadu_ps(s + i), dot);
+    }
+    if (tail) {
+        __m256 g = _mm256_maskload_ps(grad + body, tail_mask);
+        dot = _mm256_fmadd_ps(g, _mm256_maskload_ps(s + body, tail_mask), dot);
+    }
+
+    __m256 row_dot = _mm256_set1_ps(vm_hsum8_avx2(dot));
+
+    for (u64 i = 0; i < body; i += 8) {
+        __m256 d = _mm256_sub_ps(_mm256_loadu_ps(grad + i), row_dot);
+        __m256 o = _mm256_fmadd_ps(_mm256_loadu_ps(s + i), d, _mm256_loadu_ps(out + i));
+        _mm256_storeu_ps(out + i, o);
+    }
+    if (tail) {
+        __m256 d = _mm256_sub_ps(_mm256_maskload_ps(grad + body, tail_mask), row_dot);
+        __m256 o = _mm256_fmadd_ps(
+            _mm256_maskload_ps(s + body, tail_mask), d,
+            _mm256_maskload_ps(out + body, tail_mask)
+        );
+        _mm256_maskstore_ps(out + body, tail_mask, o);
+    }
+}
+
+__attribute__((target("avx2")))
+static void vm_xent_grad_add_avx2(f32* out, const f32* p, const f32* q, const f32* grad, u64 n) {
+    u64 body = n & ~(u64)7;
+    __m256 zero = _mm256_setzero_ps();
+
+    for (u64 i = 0; i < body; i += 8) {
+        __m256 p8 = _mm256_loadu_ps(p + i);
+        __m256 d = _mm256_div_ps(_mm256_mul_ps(p8, _mm256_loadu_ps(grad + i)), _mm256_loadu_ps(q + i));
+        d = _mm256_and_ps(d, _mm256_cmp_ps(p8, zero, _CMP_NEQ_UQ));
+        _mm256_storeu_ps(out + i, _mm256_sub_ps(_mm256_loadu_ps(out + i), d));
+    }
+
+    vm_xent_grad_add_scalar(out + body, p + body, q + body, grad + body, n - body);
+}
+
+#endif // CPU_X86
+
+void vm_softmax_row(f32* out, const f32* in, u64 n) {
+    if (n == 0) { return; }
+
+#if CPU_X86
+    if (cpu_has(CPU_FEATURE_AVX2 | CPU_FEATURE_FMA)) {
+        vm_softmax_row_avx2(out, in, n);
+        return;
+    }
+#endif
+
+    vm_softmax_row_scalar(out, in, n);
+}
+
+f32 vm_softmax_xent_row(
+    f32* grad, const f32* logits, const f32* target, u32 target_index, u64 n, f32 grad_scale
+) {
+    if (n == 0) { return 0.0f; }
+
+#if CPU_X86
+    if (cpu_has(CPU_FEATURE_AVX2 | CPU_FEATURE_FMA)) {
+        return vm_softmax_xent_row_avx2(grad, logits, target, target_index, n, grad_scale);
+    }
+#endif
+
+    return vm_softmax_xent_row_scalar(grad, logits, target, target_index, n, grad_scale);
+}
+
+void vm_softmax_xent_grad_add_row(
+    f32* out, const f32* logits, const f32* target, u32 target_index, u64 n, f32 grad_scale
+) {
+    if (n == 0) { return; }
+
+#if CPU_X86
+    if (cpu_has(CPU_FEATURE_AVX2 | CPU_FEATURE_FMA)) {
+        vm_softmax_xent_grad_add_row_avx2(out, logits, target, target_index, n, grad_scale);
+        return;
+    }
+#endif
+
+    vm_softmax_xent_grad_add_row_scalar(out, logits, target, target_index, n, grad_scale);
+}
+
+void vm_relu_grad_add(f32* out, const f32* in, const f32* grad, u64 n) {
+#if CPU_X86
+    if (cpu_has(CPU_FEATURE_AVX2)) {
+        vm_relu_grad_add_avx2(out, in, grad, n);
+        return;
+    }
+#endif
+
+    vm_relu_grad_add_scalar(out, in, grad, n);
+}
+
+void vm_softmax_grad_add_row(f32* out, const f32* s, const f32* grad, u64 n) {
+#if CPU_X86
+    if (cpu_has(CPU_FEATURE_AVX2 | CPU_FEATURE_FMA)) {
+        vm_softmax_grad_add_row_avx2(out, s, grad, n);
+        return;
+    }
+#endif
+
+    vm_softmax_grad_add_row_scalar(out, s, grad, n);
+}
+
+void vm_xent_grad_add(f32* out, const f32* p, const f32* q, const f32* grad, u64 n) {
+#if CPU_X86
+    if (cpu_has(CPU_FEATURE_AVX2)) {
+        vm_xent_grad_add_avx2(out, p, q, grad, n);
+        return;
+    }
+#endif
+
+    vm_xent_grad_add_scalar(out, p, q, grad, n);
+}
+
+void vm_u8_to_f32(f32* out, const u8* in, u64 n, f32 scale) {
+#if CPU_X86
+    if (cpu_has(CPU_FEATURE_AVX2)) {
+        vm_u8_to_f32_avx2(out, in, n, scale);
+        return;
+    }
+#endif
+
+    vm_u8_to_f32_scalar(out, in, n, scale);
+}
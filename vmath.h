@@ -0,0 +1,40 @@
+// Vectorized math on f32 rows
+//
+// Each routine has an AVX2 path picked at runtime and a portable fallback.
+
+// exp(x) to within a couple of ulp, inputs are clamped to the normal f32 range
+f32 vm_expf(f32 x);
+
+// out = softmax(in) over n values, out may alias in.
+// One pass for the max and the sum of exponentials together (the sum is rescaled
+// whenever the max grows), one that writes out.
+void vm_softmax_row(f32* out, const f32* in, u64 n);
+
+// Cross entropy of softmax(logits) against a target distribution, returns the loss.
+// target may be NULL, then the target is one-hot at target_index.
+// If grad isn't NULL it is set to (softmax(logits) - target) * grad_scale.
+// Works in log space from the row max, so it's stable for any logits.
+// Same two passes as vm_softmax_row, the second only when grad isn't NULL.
+f32 vm_softmax_xent_row(
+    f32* grad, const f32* logits, const f32* target, u32 target_index, u64 n, f32 grad_scale
+);
+
+// out = in * scale, widening bytes to floats
+void vm_u8_to_f32(f32* out, const u8* in, u64 n, f32 scale);
+
+// Backward passes, all of them add into out
+
+// out += grad where in > 0
+void vm_relu_grad_add(f32* out, const f32* in, const f32* grad, u64 n);
+
+// out += s * (grad - dot(grad, s)) for a softmax output row s
+void vm_softmax_grad_add_row(f32* out, const f32* s, const f32* grad, u64 n);
+
+// out += -p / q * grad, the gradient of -p * log(q) with respect to q, 0 where p is 0
+void vm_xent_grad_add(f32* out, const f32* p, const f32* q, const f32* grad, u64 n);
+
+// out += (softmax(logits) - target) * grad_scale, target as in vm_softmax_xent_row.
+// One pass over the logits for an online max and sum, one that adds into out.
+void vm_softmax_xent_grad_add_row(
+    f32* out, const f32* logits, const f32* target, u32 target_index, u64 n, f32 grad_scale
+);